@@ -0,0 +1,119 @@
+#pragma once
+#include <raylib.h>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define AABB_SIMD 1
+#endif
+
+// packed list of boxes (structure of arrays) so overlap tests run 4 lanes at a
+// time. the arrays are padded to a multiple of 4 with empty boxes that never
+// overlap anything, so the kernels never need a scalar tail.
+class AabbBatch {
+    public:
+        std::vector<float> min_x, min_y, max_x, max_y;
+
+        void clear() {
+            min_x.clear();
+            min_y.clear();
+            max_x.clear();
+            max_y.clear();
+            count = 0;
+        }
+
+        void reserve(size_t n) {
+            size_t padded = (n + 3) & ~(size_t)3;
+            min_x.reserve(padded);
+            min_y.reserve(padded);
+            max_x.reserve(padded);
+            max_y.reserve(padded);
+        }
+
+        void push_back(Rectangle r) {
+            if (count == min_x.size()) {
+                // grow by one lane group of empty boxes
+                const float inf = std::numeric_limits<float>::infinity();
+                for (int i = 0; i < 4; i++) {
+                    min_x.push_back(inf);
+                    min_y.push_back(inf);
+                    max_x.push_back(-inf);
+                    max_y.push_back(-inf);
+                }
+            }
+            min_x[count] = r.x;
+            min_y[count] = r.y;
+            max_x[count] = r.x + r.width;
+            max_y[count] = r.y + r.height;
+            count++;
+        }
+
+        size_t size() const { return count; }
+        bool empty() const { return count == 0; }
+        size_t padded_size() const { return min_x.size(); }
+
+    private:
+        size_t count = 0;
+};
+
+// same strict-inequality test as raylib's CheckCollisionRecs, 4 boxes at once.
+// returns a 4 bit lane mask
+inline int aabb_lane_mask(Rectangle r, const AabbBatch &b, size_t i) {
+#ifdef AABB_SIMD
+    __m128 hit = _mm_and_ps(
+        _mm_and_ps(_mm_cmplt_ps(_mm_set1_ps(r.x), _mm_loadu_ps(&b.max_x[i])),
+                   _mm_cmpgt_ps(_mm_set1_ps(r.x + r.width), _mm_loadu_ps(&b.min_x[i]))),
+        _mm_and_ps(_mm_cmplt_ps(_mm_set1_ps(r.y), _mm_loadu_ps(&b.max_y[i])),
+                   _mm_cmpgt_ps(_mm_set1_ps(r.y + r.height), _mm_loadu_ps(&b.min_y[i]))));
+    return _mm_movemask_ps(hit);
+#else
+    float r_max_x = r.x + r.width;
+    float r_max_y = r.y + r.height;
+    int mask = 0;
+    for (int lane = 0; lane < 4; lane++) {
+        if (r.x < b.max_x[i + lane] && r_max_x > b.min_x[i + lane] &&
+            r.y < b.max_y[i + lane] && r_max_y > b.min_y[i + lane]) {
+            mask |= 1 << lane;
+        }
+    }
+    return mask;
+#endif
+}
+
+inline int aabb_lowest_lane(int mask) {
+    for (int lane = 0; lane < 4; lane++)
+        if (mask & (1 << lane)) return lane;
+    return -1;
+}
+
+// index of the first box at or after start that overlaps r, or -1
+inline int aabb_first_hit(Rectangle r, const AabbBatch &b, size_t start = 0) {
+    for (size_t i = start & ~(size_t)3; i < b.padded_size(); i += 4) {
+        int mask = aabb_lane_mask(r, b, i);
+        if (i < start) mask &= ~((1 << (start - i)) - 1);
+        if (mask) return (int)i + aabb_lowest_lane(mask);
+    }
+    return -1;
+}
+
+inline bool aabb_any_hit(Rectangle r, const AabbBatch &b) {
+    return aabb_first_hit(r, b) >= 0;
+}
+
+// tests a small set of probes (up to 32) against every box in one pass.
+// bit n of the result is set if probes[n] overlaps any box
+inline uint32_t aabb_probe_mask(const Rectangle *probes, int probe_count, const AabbBatch &b) {
+    uint32_t all = probe_count >= 32 ? 0xFFFFFFFFu : (1u << probe_count) - 1;
+    uint32_t out = 0;
+    for (size_t i = 0; i < b.padded_size() && out != all; i += 4) {
+        for (int p = 0; p < probe_count; p++) {
+            if (!(out & (1u << p)) && aabb_lane_mask(probes[p], b, i)) {
+                out |= 1u << p;
+            }
+        }
+    }
+    return out;
+}
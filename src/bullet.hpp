@@ -1,26 +1,83 @@
 #ifndef BULLET_HPP
 #define BULLET_HPP
 
+#include "aabb.hpp"
+#include "constants.hpp"
 #include "raylib.h"
+#include <cmath>
+
+// velocities are fixed point (1/256 px per tick) so every client steps a
+// bullet to exactly the same pixel as the server
+const int BULLET_FP_SHIFT = 8;
+const float BULLET_SPEED = 10; // px per tick
 
 class Bullet {
 public:
   int x, y, shotby_id;
-  int bullet_id;
+  int bullet_id; // slot map handle, shared by server and clients
   float r = 10.0f;
-  Vector2 vel;
+  bool hit_umbrella = false; // already counted against our umbrella
+  int spawn_x, spawn_y;
+  int vx, vy;     // fixed point
+  int spawn_tick; // sim tick the bullet was fired on
+  int tick;       // sim tick x/y currently belong to
+  int rewind_ticks = 0; // server: how far back player hit checks look
+  int local_id = -1;    // id the shooter gave its predicted copy, -1 if none
+  // client: where the predicted copy was drawn relative to this one, shrinks
+  // to 0 so a correction slides instead of jumping
+  float offset_x = 0, offset_y = 0;
+
+  Bullet(int x, int y, int vx, int vy, int spawn_tick, int from_id,
+         int bullet_id = -1)
+      : x(x), y(y), shotby_id(from_id), bullet_id(bullet_id), spawn_x(x),
+        spawn_y(y), vx(vx), vy(vy), spawn_tick(spawn_tick), tick(spawn_tick) {}
+
+  Bullet()
+      : x(0), y(0), shotby_id(-1), bullet_id(-1), spawn_x(0), spawn_y(0),
+        vx(0), vy(0), spawn_tick(0), tick(0) {}
+
+  // closed form, so stepping one tick at a time or jumping gives the same spot
+  void step_to(int t) {
+    tick = t;
+    int n = t > spawn_tick ? t - spawn_tick : 0;
+    x = spawn_x + ((vx * n) >> BULLET_FP_SHIFT);
+    y = spawn_y + ((vy * n) >> BULLET_FP_SHIFT);
+  }
 
-  Bullet(int x, int y, Vector2 vel, int from_id, int bullet_id = -1)
-      : x(x), y(y), vel(vel), shotby_id(from_id), bullet_id(bullet_id) {}
+  void step() { step_to(tick + 1); }
 
-  Bullet() : x(0), y(0), vel(Vector2{0, 0}), bullet_id(-1), shotby_id(-1) {}
+  Rectangle rect() const { return {(float)x, (float)y, r * 2, r * 2}; }
 
-  void move() {
-    x += vel.x;
-    y += vel.y;
+  // where the bullet is partway between ticks (t can be fractional), for
+  // drawing at a time that isn't the simulated one
+  Vector2 position_at(double t) const {
+    double n = t > spawn_tick ? t - spawn_tick : 0;
+    return {(float)(spawn_x + vx * n / (1 << BULLET_FP_SHIFT)),
+            (float)(spawn_y + vy * n / (1 << BULLET_FP_SHIFT))};
   }
 
-  void show() { DrawCircle(x, y, r, GRAY); }
+  void show() { DrawCircle(x + (int)offset_x, y + (int)offset_y, r, GRAY); }
+
+  void show_at(Vector2 pos) {
+    DrawCircle((int)(pos.x + offset_x), (int)(pos.y + offset_y), r, GRAY);
+  }
 };
 
+// fixed point velocity for a shot fired at rot (degrees, same convention as
+// Player::rot)
+inline void bullet_velocity(float rot, int *vx, int *vy) {
+  float angleRad = (-rot + 5) * DEG2RAD;
+  *vx = (int)lroundf(cosf(angleRad) * -BULLET_SPEED * (1 << BULLET_FP_SHIFT));
+  *vy = (int)lroundf(-sinf(angleRad) * -BULLET_SPEED * (1 << BULLET_FP_SHIFT));
+}
+
+// despawn against the shared static geometry (map edge, objects, cubes).
+// both sides run this, so only player hits need to come from the server
+inline bool bullet_blocked(const Bullet &b, const AabbBatch &static_colliders) {
+  if (b.x < 0 || b.x > PLAYING_AREA.width || b.y < 0 ||
+      b.y > PLAYING_AREA.height)
+    return true;
+  return aabb_any_hit(b.rect(), static_colliders);
+}
+
 #endif
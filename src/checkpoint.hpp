@@ -0,0 +1,177 @@
+#pragma once
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#if __unix__
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// crash recovery (--checkpoint <path>): the server writes its state to a
+// memory-mapped file every CHECKPOINT_INTERVAL_MS. the file stays in the
+// page cache when the process dies, so a restart maps it and reads the
+// last checkpoint back without parsing anything but the records it needs.
+//
+// the file holds two slots and a header saying which one is current. a
+// checkpoint goes into the other slot and only then becomes current, so a
+// crash in the middle of a write leaves the previous one intact
+
+const int CHECKPOINT_INTERVAL_MS = 1000;
+// per slot, a checkpoint that doesn't fit is skipped
+const size_t CHECKPOINT_SLOT_BYTES = 8 * 1024 * 1024;
+
+class CheckpointFile {
+public:
+  ~CheckpointFile() { close_file(); }
+
+  bool open_file(const std::string &path) {
+#if __unix__
+    int fd = open(path.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+      perror("Failed to open checkpoint file");
+      return false;
+    }
+    size_t size = sizeof(Header) + 2 * CHECKPOINT_SLOT_BYTES;
+    if (ftruncate(fd, (off_t)size) < 0) {
+      perror("Failed to size checkpoint file");
+      close(fd);
+      return false;
+    }
+    void *mapped = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED) {
+      perror("Failed to map checkpoint file");
+      return false;
+    }
+    base = static_cast<char *>(mapped);
+    mapped_size = size;
+    header = reinterpret_cast<Header *>(base);
+    if (std::memcmp(header->magic, MAGIC, sizeof(header->magic)) != 0 ||
+        header->version != VERSION || header->current > 1) {
+      // new (sparse, all zero), from another build or corrupt: no checkpoint
+      std::memset(header, 0, sizeof(Header));
+      std::memcpy(header->magic, MAGIC, sizeof(header->magic));
+      header->version = VERSION;
+    }
+    return true;
+#else
+    (void)path;
+    std::cerr << "--checkpoint needs mmap, checkpoints are off" << std::endl;
+    return false;
+#endif
+  }
+
+  // the records of the current checkpoint, false if there is none (or it
+  // doesn't check out)
+  bool read(std::vector<std::string> *records) const {
+    if (!header || header->sequence == 0 || header->current > 1)
+      return false;
+    const Slot &slot = header->slots[header->current];
+    if (slot.length > CHECKPOINT_SLOT_BYTES)
+      return false;
+    const char *data = slot_data(header->current);
+    if (checksum(data, slot.length) != slot.checksum)
+      return false;
+
+    records->clear();
+    size_t at = 0;
+    while (at + sizeof(uint32_t) <= slot.length) {
+      uint32_t length;
+      std::memcpy(&length, data + at, sizeof(length));
+      at += sizeof(length);
+      if (at + length > slot.length)
+        return false;
+      records->emplace_back(data + at, length);
+      at += length;
+    }
+    return true;
+  }
+
+  // writes a checkpoint into the spare slot and makes it current. runs on
+  // the checkpoint thread, never the tick
+  bool write(const std::vector<std::string> &records) {
+    if (!header)
+      return false;
+    size_t length = 0;
+    for (const std::string &record : records)
+      length += sizeof(uint32_t) + record.size();
+    if (length > CHECKPOINT_SLOT_BYTES) {
+      std::cerr << "Checkpoint of " << length << " bytes doesn't fit, skipped"
+                << std::endl;
+      return false;
+    }
+
+    int spare = header->sequence == 0 ? 0 : 1 - header->current;
+    char *data = slot_data(spare);
+    size_t at = 0;
+    for (const std::string &record : records) {
+      uint32_t size = (uint32_t)record.size();
+      std::memcpy(data + at, &size, sizeof(size));
+      at += sizeof(size);
+      std::memcpy(data + at, record.data(), record.size());
+      at += record.size();
+    }
+    header->slots[spare].length = length;
+    header->slots[spare].checksum = checksum(data, length);
+
+    // the slot is complete before the header points at it. the kernel has
+    // the pages either way, a crash of the process alone loses nothing
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    header->current = spare;
+    header->sequence++;
+#if __unix__
+    msync(base, mapped_size, MS_ASYNC);
+#endif
+    return true;
+  }
+
+private:
+  static constexpr const char *MAGIC = "LSCKPT01";
+  static const uint32_t VERSION = 1;
+
+  struct Slot {
+    uint64_t length;
+    uint32_t checksum;
+    uint32_t unused;
+  };
+  struct Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t current; // slot of the last complete checkpoint
+    uint64_t sequence; // checkpoints written, 0 = none yet
+    Slot slots[2];
+  };
+
+  char *base = nullptr;
+  size_t mapped_size = 0;
+  Header *header = nullptr;
+
+  char *slot_data(int slot) const {
+    return base + sizeof(Header) + slot * CHECKPOINT_SLOT_BYTES;
+  }
+
+  // fnv-1a, enough to notice a torn or stale slot
+  static uint32_t checksum(const char *data, size_t length) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < length; i++) {
+      hash ^= (uint8_t)data[i];
+      hash *= 16777619u;
+    }
+    return hash;
+  }
+
+  void close_file() {
+#if __unix__
+    if (base)
+      munmap(base, mapped_size);
+#endif
+    base = nullptr;
+    header = nullptr;
+  }
+};
@@ -1,9 +1,11 @@
+#include "aabb.hpp"
 #include "bullet.hpp"
 #include "codes.hpp"
 #include "constants.hpp"
 #include "drawScale.hpp"
 #include "game.hpp"
 #include "game_config.hpp"
+#include "interest.hpp"
 #include "math.h"
 #include "netvent.hpp"
 #include "networking.hpp"
@@ -14,11 +16,18 @@
 #include "raylib.h"
 #include "raymath.h"
 #include "resource_manager.hpp"
+#include "sim_clock.hpp"
+#include "snapshot.hpp"
 #include "umbrella.hpp"
 #include "utils.hpp"
+#include "world.hpp"
+#include <algorithm>
 #include <atomic>
 #include <chrono>
+#include <csignal>
 #include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
 #include <list>
 #include <map>
@@ -28,6 +37,7 @@
 #include <sstream>
 #include <string>
 #include <thread>
+#include <unordered_map>
 #include <vector>
 
 // Charging station constants and definitions
@@ -39,6 +49,7 @@ struct ChargingPoint {
   int x, y;
 };
 
+// for the default world size, place_landmarks moves them to the server's
 ChargingPoint charging_points[4] = {
     {CHARGE_OFFSET, (int)(PLAYING_AREA.height / 2) - CHARGE_OFFSET},
     {(int)PLAYING_AREA.width - CHARGE_OFFSET - CHARGE_SIZE,
@@ -48,7 +59,8 @@ ChargingPoint charging_points[4] = {
      (int)PLAYING_AREA.height - CHARGE_OFFSET - CHARGE_SIZE}};
 
 // Remove global socket declaration - will be created in main()
-int sock = -1; // Will be initialized in main()
+// the recv thread swaps in a new one when it reconnects
+std::atomic<int> sock{-1}; // Will be initialized in main()
 
 std::mutex packets_mutex;
 std::list<std::string> packets = {};
@@ -93,11 +105,111 @@ static Rectangle umbrella_barrel = {
     BARREL_COLLISION_SIZE,
     BARREL_COLLISION_SIZE}; // middle of the playing field
 
-// cubes
-std::vector<Object> cubes;
+// the chunks of the map around us. the server sends the seed on join and
+// each chunk's map objects and cube checksum when we ask; the cubes are
+// rebuilt from the seed
+static ChunkMap chunks;
+static uint32_t map_seed = 0;
+static int map_version = -1; // -1 until the game state arrived
+// chunks asked for and not received yet -> sim tick of the request
+static std::unordered_map<int64_t, int> requested_chunks;
+// an unanswered chunk request is sent again after this long
+const int CHUNK_REQUEST_RETRY_TICKS = SIM_TICK_RATE;
+
+// server time base (synced from MSG_CLIENT_ID)
+SimClock sim_clock;
+
+// a dropped connection is made again to the same server, and the token we
+// got on join (MSG_CLIENT_ID) gets our player back if that's within
+// RESUME_GRACE_MS. both set on the main thread, read by the recv thread
+static socket_address_in server_address;
+static std::mutex resume_mutex;
+static std::string resume_token;
+const int RECONNECT_INTERVAL_MS = 500;
+
+// what we know as of each snapshot, the server sends deltas against these
+static SnapshotRing snapshot_views;
+
+// per frame collider packs
+static AabbBatch bullet_rects;
+static AabbBatch player_rects;
+
+// authoritative movement (server started with --authoritative): we send
+// input commands, predict them locally and replay the unacked ones whenever
+// the server corrects our position
+bool server_authoritative = false;
+static int input_seq = 0;
+static std::vector<InputCommand> pending_inputs; // applied locally, not acked
+static std::vector<InputCommand> unsent_inputs;
+
+// the client simulates in the server's tick, rendering runs at any rate
+const double CLIENT_TICK_MS = 1000.0 / SIM_TICK_RATE;
+// longer frames than this (window dragged, breakpoint) are cut short
+const double MAX_FRAME_MS = 250.0;
+// movement / input batches go out every this many ticks
+const int SEND_INTERVAL_TICKS = 5;
+// ticks between two shots
+const int FIRE_COOLDOWN_TICKS = 20;
+
+// remote players and their bullets are drawn this far in the past
+// (--interp-delay), so there's usually a server state on both sides
+static int interp_delay_ms = DEFAULT_INTERP_DELAY_MS;
+
+// our own shots are drawn the moment we fire, under a local id, until the
+// server's spawn for them (which echoes that id) replaces them
+struct PredictedShot {
+  Bullet bullet;
+  int64_t fired_ms;
+};
+static std::vector<PredictedShot> predicted_shots;
+static int next_local_bullet_id = 0;
+// no spawn by then means the server dropped the shot
+const int64_t PREDICTED_SHOT_TIMEOUT_MS = 1000;
+// corrections bigger than this snap, smaller ones slide over a few frames
+const float BULLET_SNAP_DISTANCE = 100.0f;
+const float BULLET_CORRECTION_DECAY = 0.8f;
+
+// the first message on every connection: empty for a new player, else
+// the token of the one we had
+void send_resume(int s, const std::string &token) {
+  send_message(netvent::serialize_to_netvent(
+                   netvent::val(MSG_RESUME),
+                   std::map<std::string, netvent::Value>(
+                       {{"token", netvent::val(token)}})),
+               s);
+}
 
-// move state
-CanMoveState can_move_state = {false, false, false, false};
+// connects again and asks for our player back. false if we never joined or
+// the grace period ran out. a token the server doesn't know anymore just
+// gets us a normal join
+bool reconnect() {
+  std::string token;
+  {
+    std::lock_guard<std::mutex> lock(resume_mutex);
+    token = resume_token;
+  }
+  if (token.empty())
+    return false;
+  // a message the drop cut off won't be finished
+  network_buffer.clear();
+
+  auto deadline = std::chrono::steady_clock::now() +
+                  std::chrono::milliseconds(RESUME_GRACE_MS);
+  while (running && std::chrono::steady_clock::now() < deadline) {
+    int s = create_socket(ADDRESS_FAMILY_INET, SOCKET_STREAM, 0);
+    if (s >= 0 && connect_socket(s, (struct sockaddr *)&server_address,
+                                 sizeof(server_address)) == 0) {
+      send_resume(s, token);
+      close_socket(sock.exchange(s));
+      std::cout << "Reconnected, resuming" << std::endl;
+      return true;
+    }
+    if (s >= 0)
+      close_socket(s);
+    std::this_thread::sleep_for(std::chrono::milliseconds(RECONNECT_INTERVAL_MS));
+  }
+  return false;
+}
 
 void do_recv() {
   char buffer[1024];
@@ -105,12 +217,14 @@ void do_recv() {
   while (running) {
     int bytes = recv_data(sock, &buffer, sizeof(buffer), 0);
 
-    if (bytes == 0) {
-      std::cout << "Server disconnected.\n";
-      running = false;
-      break;
-    } else if (bytes < 0) {
-      print_socket_error("Error receiving packet");
+    if (bytes <= 0) {
+      if (bytes == 0) {
+        std::cout << "Server disconnected.\n";
+      } else {
+        print_socket_error("Error receiving packet");
+      }
+      if (running && reconnect())
+        continue;
       running = false;
       break;
     }
@@ -138,6 +252,74 @@ enum EventType {
   NOTHING = 100
 };
 
+// the barrel and chargers sit relative to the world size
+void place_landmarks(ResourceManager *res_man) {
+  init_map_objects(res_man->getTex("assets/barrel.png"),
+                   res_man->getTex("assets/charger.png"));
+  int charger = 0;
+  for (const Object &obj : objects) {
+    if (obj.type == ObjectType::Barrel) {
+      umbrella_barrel = obj.bounds;
+    } else if (obj.type == ObjectType::Charger && charger < 4) {
+      charging_points[charger++] = {(int)obj.bounds.x, (int)obj.bounds.y};
+    }
+  }
+}
+
+void set_chunk_cubes(Chunk &chunk, std::vector<Object> cubes,
+                     ResourceManager *res_man) {
+  chunk.cubes = std::move(cubes);
+  for (Object &cube : chunk.cubes) {
+    cube.texture = res_man->getTex("assets/cube.png");
+    cube.tint = {100, 100, 255, 255};
+  }
+}
+
+// asks for the chunks around (x, y) we don't have and drops the far ones
+void update_chunks(int x, int y, int tick) {
+  if (map_version == -1)
+    return;
+  int px = chunk_of(x), py = chunk_of(y);
+
+  for (int cy = py - CHUNK_LOAD_RADIUS; cy <= py + CHUNK_LOAD_RADIUS; cy++) {
+    for (int cx = px - CHUNK_LOAD_RADIUS; cx <= px + CHUNK_LOAD_RADIUS; cx++) {
+      if (!chunk_in_world(cx, cy) || chunks.find(cx, cy))
+        continue;
+      auto requested = requested_chunks.find(chunk_key(cx, cy));
+      if (requested != requested_chunks.end() &&
+          tick - requested->second < CHUNK_REQUEST_RETRY_TICKS)
+        continue;
+      requested_chunks[chunk_key(cx, cy)] = tick;
+      send_message(netvent::serialize_to_netvent(
+                       netvent::val(MSG_CHUNK_REQUEST),
+                       std::map<std::string, netvent::Value>(
+                           {{"x", netvent::val(cx)}, {"y", netvent::val(cy)}})),
+                   sock);
+    }
+  }
+
+  auto far = [px, py](int cx, int cy) {
+    return std::abs(cx - px) > CHUNK_EVICT_RADIUS ||
+           std::abs(cy - py) > CHUNK_EVICT_RADIUS;
+  };
+  std::vector<std::pair<int, int>> evict;
+  for (const auto &[key, chunk] : chunks) {
+    if (far(chunk.x, chunk.y))
+      evict.push_back({chunk.x, chunk.y});
+  }
+  for (const auto &[cx, cy] : evict)
+    chunks.erase(cx, cy);
+  // a late answer for a chunk we walked away from is dropped
+  for (auto it = requested_chunks.begin(); it != requested_chunks.end();) {
+    int cx = (int)(it->first >> 32), cy = (int)(uint32_t)it->first;
+    if (far(cx, cy)) {
+      it = requested_chunks.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
 void handle_packet(int packet_type, std::string payload, Game *game,
                    int *my_id, ResourceManager *res_man) {
   std::istringstream in(payload);
@@ -148,13 +330,30 @@ void handle_packet(int packet_type, std::string payload, Game *game,
     std::cout << "Received game state: " << payload << std::endl;
     auto [event_name, data] = netvent::deserialize_from_netvent(payload);
     if (event_name.as_int() == MSG_GAME_STATE) {
+      // a new room (or the first one): nothing from the last one carries over
+      game->players.clear();
+      game->bullets.clear();
+      snapshot_views = SnapshotRing();
+      predicted_shots.clear();
+      darkness_active = false;
+      acid_rain.stop();
+      is_assassin = false;
+      my_target_id = -1;
+
       auto players_table = data["players"].as_table();
       for (const auto& [key, value] : players_table.get_data_map()) {
         int player_id = key.as_int();
-        auto player = Player(value.as_table());
-        (*game).players[player_id] = player;
+        (*game).players[player_id] = Player(value.as_table());
+        (*game).players.looks(player_id) = PlayerLooks(value.as_table());
       }
-      cubes = objects_from_table(data["cubes"].as_table(), res_man->getTex("assets/cube.png"));
+      // a new map: its size, and the seed the chunks' cubes come from
+      if (data.find("world_tiles") != data.end())
+        set_playing_area_tiles(data["world_tiles"].as_int());
+      place_landmarks(res_man);
+      map_seed = (uint32_t)data["map_seed"].as_int();
+      map_version = data["map_version"].as_int();
+      chunks.clear();
+      requested_chunks.clear();
       int current_event = data["current_event"].as_int();
       if (current_event == EventType::Darkness) {
         darkness_active = true;
@@ -162,7 +361,8 @@ void handle_packet(int packet_type, std::string payload, Game *game,
         acid_rain.start(0.0f);
       } else if (current_event == EventType::Assasin) {
         int assassin_id = data["assassin_id"].as_int();
-        game->players[assassin_id].color = INVISIBLE;
+        if (game->players.count(assassin_id))
+          game->players.looks(assassin_id).color = INVISIBLE;
         if (assassin_id == *my_id) {
           is_assassin = true;
           my_target_id = data["target_id"].as_int();
@@ -171,35 +371,175 @@ void handle_packet(int packet_type, std::string payload, Game *game,
       break;
     }
   }
+  case MSG_CHUNK: {
+    auto [event_name, data] = netvent::deserialize_from_netvent(payload);
+    if (event_name.as_int() == MSG_CHUNK) {
+      int cx = data["x"].as_int();
+      int cy = data["y"].as_int();
+      if (!requested_chunks.erase(chunk_key(cx, cy)))
+        break; // not wanted anymore
+
+      Chunk chunk;
+      chunk.x = cx;
+      chunk.y = cy;
+      chunk.objects = std::make_shared<const std::vector<Object>>(
+          objects_from_table(data["objects"].as_table(), Texture2D{}));
+      // rebuild the cubes from the seed, if our generator is the same one
+      std::vector<Object> cubes;
+      if (map_version == MAP_GEN_VERSION)
+        cubes = chunk_cubes(map_seed, cx, cy, objects);
+      if (map_version == MAP_GEN_VERSION &&
+          (int)cubes_checksum(cubes) == data["cubes_checksum"].as_int()) {
+        set_chunk_cubes(chunk, cubes, res_man);
+      } else {
+        std::cout << "Chunk " << cx << "," << cy << " of map " << map_seed
+                  << " (version " << map_version
+                  << ") doesn't match ours, asking for its cubes" << std::endl;
+        send_message(netvent::serialize_to_netvent(
+                         netvent::val(MSG_MAP_REQUEST),
+                         std::map<std::string, netvent::Value>(
+                             {{"x", netvent::val(cx)}, {"y", netvent::val(cy)}})),
+                     sock);
+      }
+      chunks.put(std::move(chunk));
+    }
+  } break;
+  case MSG_MAP_CUBES: {
+    auto [event_name, data] = netvent::deserialize_from_netvent(payload);
+    if (event_name.as_int() == MSG_MAP_CUBES) {
+      Chunk *loaded = chunks.find(data["x"].as_int(), data["y"].as_int());
+      if (!loaded)
+        break;
+      // put again so the colliders are rebuilt
+      Chunk chunk = *loaded;
+      set_chunk_cubes(chunk,
+                      objects_from_table(data["cubes"].as_table(), Texture2D{}),
+                      res_man);
+      chunks.put(std::move(chunk));
+    }
+  } break;
   case MSG_CLIENT_ID: {
     auto [event_name, data] = netvent::deserialize_from_netvent(payload);
     if (event_name.as_int() == MSG_CLIENT_ID) {
       *my_id = data["id"].as_int();
+      if (data.find("room") != data.end())
+        std::cout << "Joined room " << data["room"].as_int() << std::endl;
+      sim_clock.sync(join_time(data["server_time_hi"].as_int(),
+                               data["server_time_lo"].as_int()));
+      if (data.find("authoritative") != data.end())
+        server_authoritative = data["authoritative"].as_int() != 0;
+      if (data.find("token") != data.end()) {
+        std::lock_guard<std::mutex> lock(resume_mutex);
+        resume_token = data["token"].as_string();
+      }
     }
     break;
   }
-  case MSG_PLAYER_MOVE: {
+  case MSG_RESUMED: {
     auto [event_name, data] = netvent::deserialize_from_netvent(payload);
-    if (event_name.as_int() == MSG_PLAYER_MOVE) {
-      int id = data["id"].as_int();
-      int x = data["x"].as_int();
-      int y = data["y"].as_int();
-      float rot = data["rot"].as_float();
-
-      if (id == *my_id)
-        break; 
+    if (event_name.as_int() == MSG_RESUMED) {
+      // our old player: the players that came meanwhile follow as
+      // MSG_PLAYER_NEW, the ones that left go, and the snapshots carry on
+      // from the last one we acked
+      *my_id = data["id"].as_int();
+      std::cout << "Resumed as player " << *my_id << " in room "
+                << data["room"].as_int() << std::endl;
+      sim_clock.sync(join_time(data["server_time_hi"].as_int(),
+                               data["server_time_lo"].as_int()));
+
+      std::vector<int> present;
+      for (const netvent::Value &id : data["players"].as_table().get_data_vector())
+        present.push_back(id.as_int());
+      std::vector<int> gone;
+      for (const auto &[id, p] : game->players) {
+        if (id != *my_id &&
+            std::find(present.begin(), present.end(), id) == present.end())
+          gone.push_back(id);
+      }
+      for (int id : gone)
+        game->players.erase(id);
 
-      if ((*game).players.find(id) != (*game).players.end()) {
-        if (color_equal((*game).players.at(id).color, INVISIBLE) &&
-            id != *my_id) {
-          // std::cout << "Client " << *my_id << ": Assassin " << id << " moved
-          // to (" << x << ", " << y << ") with rotation " << rot << std::endl;
+      darkness_active = data["darkness"].as_int() != 0;
+      if (data["acid_rain"].as_int() == 0) {
+        acid_rain.stop();
+      } else if (!acid_rain.is_active()) {
+        acid_rain.start(0.0f);
+      }
+      is_assassin = data["assassin_id"].as_int() == *my_id;
+      my_target_id = is_assassin ? data["target_id"].as_int() : -1;
+    }
+  } break;
+  case MSG_SNAPSHOT: {
+    auto [event_name, data] = netvent::deserialize_from_netvent(payload);
+    if (event_name.as_int() == MSG_SNAPSHOT) {
+      int seq = data["seq"].as_int();
+      int base = data["base"].as_int();
+
+      SnapshotView view;
+      view.seq = seq;
+      if (base != -1) {
+        SnapshotView *baseline = snapshot_views.find(base);
+        if (!baseline) {
+          // not acked, the server falls back to an older baseline
+          std::cout << "Snapshot " << seq << " against unknown baseline "
+                    << base << std::endl;
+          break;
         }
+        view.players = baseline->players;
+      }
+
+      for (netvent::Value &entry :
+           data["players"].as_table().get_data_vector()) {
+        netvent::Table &t = entry.as_table();
+        int id = t[netvent::val("id")].as_int();
+        PlayerState &s = view.players[id];
+        int fields = apply_player_state_delta(s, t);
+
+        // only what changed, older fields may have been set by other messages
+        if (id == *my_id || game->players.find(id) == game->players.end())
+          continue;
+        Player &p = game->players.at(id);
+        if (fields & FIELD_ROT)
+          p.rot = s.rot;
+        if (fields & FIELD_WEAPON)
+          p.weapon_id = s.weapon_id;
+        PlayerLooks &looks = game->players.looks(id);
+        if (fields & FIELD_COLOR)
+          looks.color = s.color;
+        if (fields & FIELD_USERNAME)
+          looks.username = s.username;
+      }
 
-        (*game).players.at(id).nx = x;
-        (*game).players.at(id).ny = y;
-        (*game).players.at(id).rot = rot;
+      // every player in the view was where the view says at this time,
+      // changed or not
+      int64_t time_ms = join_time(data["time_hi"].as_int(), data["time_lo"].as_int());
+      for (const auto &[id, state] : view.players) {
+        if (id != *my_id && game->players.count(id))
+          game->players.motion(id).push(time_ms, (float)state.x, (float)state.y);
+      }
+      snapshot_views.put(std::move(view));
+
+      // authoritative movement: take the server's position and replay
+      // whatever it hasn't applied yet on top of it
+      if (data.find("ack") != data.end() &&
+          game->players.find(*my_id) != game->players.end()) {
+        int ack = data["ack"].as_int();
+        Player &me = game->players.at(*my_id);
+        me.x = data["x"].as_int();
+        me.y = data["y"].as_int();
+
+        pending_inputs.erase(
+            std::remove_if(pending_inputs.begin(), pending_inputs.end(),
+                           [ack](const InputCommand &cmd) { return cmd.seq <= ack; }),
+            pending_inputs.end());
+        for (const InputCommand &cmd : pending_inputs)
+          simulate_move(me, cmd.keys, chunks.cube_colliders_near(me.x, me.y));
       }
+
+      std::string ack = netvent::serialize_to_netvent(
+          netvent::val(MSG_SNAPSHOT_ACK),
+          std::map<std::string, netvent::Value>({{"seq", netvent::val(seq)}}));
+      send_message(ack, sock);
     }
   } break;
   case MSG_PLAYER_NEW: {
@@ -214,9 +554,9 @@ void handle_packet(int packet_type, std::string payload, Game *game,
       int weapon_id = data["weapon_id"].as_int();
 
       (*game).players[id] = Player(x, y);
-      (*game).players[id].username = username;
-      (*game).players[id].color = color_from_table(color_table);
       (*game).players[id].weapon_id = weapon_id;
+      (*game).players.looks(id).username = username;
+      (*game).players.looks(id).color = color_from_table(color_table);
     }
 
     break;
@@ -268,10 +608,11 @@ void handle_packet(int packet_type, std::string payload, Game *game,
       netvent::Table color_table = data["color"].as_table();
 
       if (game->players.count(id)) {
-        Color old_color = game->players.at(id).color;
-        game->players.at(id).username = username;
+        PlayerLooks &looks = game->players.looks(id);
+        Color old_color = looks.color;
+        looks.username = username;
         Color new_color = color_from_table(color_table);
-        game->players.at(id).color = new_color;
+        looks.color = new_color;
 
         std::cout << "Player " << id << " color changed from "
                   << color_to_string(old_color) << " to "
@@ -297,46 +638,68 @@ void handle_packet(int packet_type, std::string payload, Game *game,
       }
     }
   } break;
-  case MSG_BULLET_SHOT: {
+  case MSG_BULLET_BATCH: {
     auto [event_name, data] = netvent::deserialize_from_netvent(payload);
-    if (event_name.as_int() == MSG_BULLET_SHOT) {
-      int from_id = data["player_id"].as_int();
-      int bullet_id = data["bullet_id"].as_int();
-      int x = data["x"].as_int();
-      int y = data["y"].as_int();
-      float rot = data["rot"].as_float();
-
-      float angleRad = (-rot + 5) * DEG2RAD;
-      float bspeed = 10;
-
-      Vector2 dir = Vector2Scale({cosf(angleRad), -sinf(angleRad)}, -bspeed);
-
-      std::cout << "Client: Received bullet " << bullet_id << " from player " << from_id 
-                << " at (" << x << ", " << y << ")" << std::endl;
+    if (event_name.as_int() == MSG_BULLET_BATCH) {
+      std::vector<netvent::Value> ids = data["spawn_ids"].as_table().get_data_vector();
+      std::vector<netvent::Value> owners = data["spawn_owners"].as_table().get_data_vector();
+      std::vector<netvent::Value> xs = data["spawn_xs"].as_table().get_data_vector();
+      std::vector<netvent::Value> ys = data["spawn_ys"].as_table().get_data_vector();
+      std::vector<netvent::Value> vxs = data["spawn_vxs"].as_table().get_data_vector();
+      std::vector<netvent::Value> vys = data["spawn_vys"].as_table().get_data_vector();
+      std::vector<netvent::Value> ticks = data["spawn_ticks"].as_table().get_data_vector();
+      std::vector<netvent::Value> local_ids;
+      if (data.find("spawn_local_ids") != data.end())
+        local_ids = data["spawn_local_ids"].as_table().get_data_vector();
+
+      // spawns first, a bullet can spawn and hit in the same tick. the bullet
+      // is then stepped from its spawn tick by Game::update_bullets
+      for (size_t i = 0; i < ids.size(); i++) {
+        int bullet_id = ids[i].as_int();
+        Bullet b(xs[i].as_int(), ys[i].as_int(), vxs[i].as_int(), vys[i].as_int(),
+                 ticks[i].as_int(), owners[i].as_int(), bullet_id);
+
+        // one of ours: take over from the predicted copy, starting where it
+        // was drawn
+        int local_id = i < local_ids.size() ? local_ids[i].as_int() : -1;
+        if (b.shotby_id == *my_id && local_id != -1) {
+          auto shot = std::find_if(predicted_shots.begin(), predicted_shots.end(),
+                                   [&](const PredictedShot &s) {
+                                     return s.bullet.local_id == local_id;
+                                   });
+          if (shot != predicted_shots.end()) {
+            Bullet at = b;
+            at.step_to(shot->bullet.tick);
+            float dx = (float)(shot->bullet.x - at.x);
+            float dy = (float)(shot->bullet.y - at.y);
+            if (dx * dx + dy * dy <= BULLET_SNAP_DISTANCE * BULLET_SNAP_DISTANCE) {
+              b.offset_x = dx;
+              b.offset_y = dy;
+            }
+            predicted_shots.erase(shot);
+          }
+        }
+        game->bullets.insert_at(bullet_id, b);
+      }
 
-      Bullet new_bullet(x, y, dir, from_id, bullet_id);
-      game->bullets.push_back(new_bullet);
+      // authoritative player hits. bullets that hit static geometry are
+      // already gone locally
+      for (const netvent::Value &id : data["hit_ids"].as_table().get_data_vector()) {
+        game->bullets.erase(id.as_int());
+      }
     }
     break;
   }
-  case MSG_BULLET_DESPAWN: {
+  case MSG_ROOM_LIST: {
     auto [event_name, data] = netvent::deserialize_from_netvent(payload);
-    if (event_name.as_int() == MSG_BULLET_DESPAWN) {
-      int bullet_id = data["bullet_id"].as_int();
-
-      size_t before_size = game->bullets.size();
-      game->bullets.erase(std::remove_if(game->bullets.begin(),
-                                         game->bullets.end(),
-                                         [bullet_id](const Bullet &b) {
-                                           return b.bullet_id == bullet_id;
-                                         }),
-                          game->bullets.end());
-      size_t after_size = game->bullets.size();
-
-      if (before_size != after_size) {
-        std::cout << "Client: Removed bullet " << bullet_id << std::endl;
-      } else {
-        std::cout << "Client: Warning - Tried to remove non-existent bullet " << bullet_id << std::endl;
+    if (event_name.as_int() == MSG_ROOM_LIST) {
+      auto ids = data["ids"].as_table().get_data_vector();
+      auto players = data["players"].as_table().get_data_vector();
+      std::cout << "Rooms (we're in " << data["room"].as_int() << ", up to "
+                << data["room_size"].as_int() << " players each):" << std::endl;
+      for (size_t i = 0; i < ids.size() && i < players.size(); i++) {
+        std::cout << "  room " << ids[i].as_int() << ": "
+                  << players[i].as_int() << " players" << std::endl;
       }
     }
     break;
@@ -352,7 +715,8 @@ void handle_packet(int packet_type, std::string payload, Game *game,
                 << " is targeting player " << target_id << std::endl;
 
       if (assassin_id == *my_id) {
-        game->players[assassin_id].color = INVISIBLE;
+        if (game->players.count(assassin_id))
+          game->players.looks(assassin_id).color = INVISIBLE;
         is_assassin = true;
         my_target_id = target_id;
 
@@ -365,24 +729,10 @@ void handle_packet(int packet_type, std::string payload, Game *game,
     }
     break;
   }
-  case MSG_SWITCH_WEAPON: {
-    auto [event_name, data] = netvent::deserialize_from_netvent(payload);
-    if (event_name.as_int() == MSG_SWITCH_WEAPON) {
-      int player_id = data["player_id"].as_int();
-      int weapon_id = data["weapon_id"].as_int();
-
-      std::cout << "Client: Player " << player_id << " switched weapon to "
-                << weapon_id << std::endl;
-
-      if (player_id != *my_id) {
-        game->players[player_id].weapon_id = weapon_id;
-      }
-    }
-  } break;
   }
 }
 
-void cube_loop(std::vector<Object> cubes, Camera2D cam, ResourceManager *res_man) {
+void cube_loop(std::vector<Object> &cubes, Camera2D cam, ResourceManager *res_man) {
   for (Object& cube : cubes) {
     if (isInViewport(cube.bounds.x, cube.bounds.y, cube.bounds.width, cube.bounds.height, cam)) {
       cube.draw();
@@ -601,8 +951,7 @@ void draw_flashlight_cone(Vector2 playerScreenPos, float player_rotation) {
   DrawTriangle(player_center, cone_right, outer_right, edge_cone_color);
 }
 
-void draw_ui(Color my_ui_color, playermap players, std::vector<Bullet> bullets,
-             int my_id, int shoot_cooldown, Camera2D cam, float scale) {
+void draw_ui(Color my_ui_color, const playermap &players, int my_id, int shoot_cooldown, Camera2D cam, float scale) {
   BeginUiDrawing();
 
   DrawFPS(0, 0);
@@ -615,8 +964,8 @@ void draw_ui(Color my_ui_color, playermap players, std::vector<Bullet> bullets,
     if (my_target_id == my_id) {
       DrawText("Pending...", 330, 50, 12, YELLOW);
     } else if (players.count(my_target_id)) {
-      DrawText(players[my_target_id].username.c_str(), 330, 50, 12,
-               players[my_target_id].color);
+      DrawText(players.looks(my_target_id).username.c_str(), 330, 50, 12,
+               players.looks(my_target_id).color);
     } else {
       DrawText("Unknown", 330, 50, 12, RED);
     }
@@ -629,7 +978,7 @@ void draw_ui(Color my_ui_color, playermap players, std::vector<Bullet> bullets,
   const float textSize = 24;
   const float textPadding = 50;
   const float textWidth =
-      MeasureText(players[my_id].username.c_str(), textSize);
+      MeasureText(players.looks(my_id).username.c_str(), textSize);
   float boxWidth = textPadding + textWidth + (padding * 2);
 
   // fix name clipping out of box
@@ -646,7 +995,7 @@ void draw_ui(Color my_ui_color, playermap players, std::vector<Bullet> bullets,
   // player info
   DrawRectangle(padding, y + (boxHeight - squareSize) / 2, squareSize,
                 squareSize, my_ui_color);
-  DrawText(players[my_id].username.c_str(), textPadding,
+  DrawText(players.looks(my_id).username.c_str(), textPadding,
            y + (boxHeight - textSize) / 2, textSize, WHITE);
 
   // cooldown bar
@@ -683,15 +1032,15 @@ void draw_ui(Color my_ui_color, playermap players, std::vector<Bullet> bullets,
         if (id == my_id) {
           DrawRectangle(window_size.x - 100 + p.x / (PLAYING_AREA.width / 100),
                         p.y / (PLAYING_AREA.height / 100), 10, 10, my_ui_color);
-        } else if (!color_equal(p.color, INVISIBLE)) {
+        } else if (!color_equal(players.looks(id).color, INVISIBLE)) {
           DrawRectangle(window_size.x - 100 + p.x / (PLAYING_AREA.width / 100),
-                        p.y / (PLAYING_AREA.height / 100), 10, 10, p.color);
+                        p.y / (PLAYING_AREA.height / 100), 10, 10, players.looks(id).color);
         }
       }
     } else {
       for (auto &[id, p] : players) {
         if (id == my_id || p.weapon_id == Weapon::flashlight) {
-          Color display_color = (id == my_id) ? my_ui_color : p.color;
+          Color display_color = (id == my_id) ? my_ui_color : players.looks(id).color;
           float map_x =
               window_size.x - 100 + (p.x / (PLAYING_AREA.width / 100));
           float map_y = (p.y / (PLAYING_AREA.height / 100));
@@ -715,9 +1064,9 @@ void draw_ui(Color my_ui_color, playermap players, std::vector<Bullet> bullets,
       if (id == my_id) {
         DrawRectangle(window_size.x - 100 + p.x / (PLAYING_AREA.width / 100),
                       p.y / (PLAYING_AREA.height / 100), 10, 10, my_ui_color);
-      } else if (!color_equal(p.color, INVISIBLE)) {
+      } else if (!color_equal(players.looks(id).color, INVISIBLE)) {
         DrawRectangle(window_size.x - 100 + p.x / (PLAYING_AREA.width / 100),
-                      p.y / (PLAYING_AREA.height / 100), 10, 10, p.color);
+                      p.y / (PLAYING_AREA.height / 100), 10, 10, players.looks(id).color);
       }
     }
   }
@@ -725,24 +1074,25 @@ void draw_ui(Color my_ui_color, playermap players, std::vector<Bullet> bullets,
   EndUiDrawing();
 }
 
-void draw_players(playermap players, std::vector<Bullet> bullets,
+void draw_players(const playermap &players, const AabbBatch &bullets,
                   ResourceManager *res_man, int my_id) {
   for (auto &[id, p] : players) {
-    if (p.username == "unset")
+    const PlayerLooks &looks = players.looks(id);
+    if (looks.username == "unset")
       continue; // skip unset players
 
-    if (!color_equal(p.color, INVISIBLE) || id == my_id) {
+    if (!color_equal(looks.color, INVISIBLE) || id == my_id) {
       Color shadow_color = {0, 0, 0, 80};
       float shadow_width = 80;
       float shadow_height = 30;
       float shadow_y_offset = 90;
       DrawEllipse(p.x + 50, p.y + shadow_y_offset, shadow_width/2, shadow_height/2, shadow_color);
 
-      Color clr = p.color;
+      Color clr = looks.color;
       if (id == my_id && is_assassin) {
         DrawTextureAlpha(res_man->load_player_texture_from_color(my_true_color),
                          p.x, p.y, 128);
-      } else if (id == my_id && color_equal(p.color, INVISIBLE)) {
+      } else if (id == my_id && color_equal(looks.color, INVISIBLE)) {
         DrawTextureAlpha(res_man->load_player_texture_from_color(my_true_color),
                          p.x, p.y, 128);
       } else {
@@ -750,8 +1100,8 @@ void draw_players(playermap players, std::vector<Bullet> bullets,
                     WHITE);
       }
 
-      DrawText(p.username.c_str(),
-               p.x + 50 - MeasureText(p.username.c_str(), 32) / 2, p.y - 50, 32,
+      DrawText(looks.username.c_str(),
+               p.x + 50 - MeasureText(looks.username.c_str(), 32) / 2, p.y - 50, 32,
                BLACK);
     }
 
@@ -766,11 +1116,11 @@ void draw_players(playermap players, std::vector<Bullet> bullets,
                        {(float)0, (float)0, 16, 16},
                        {player_center.x, player_center.y, 80, 80},
                        {(float)40 + knife_offset, (float)40}, p.rot, WHITE);
-      } else if (color_equal(p.color, INVISIBLE) && id != my_id) {
+      } else if (color_equal(looks.color, INVISIBLE) && id != my_id) {
         if (players.count(my_id)) {
-          float distance = sqrtf(powf(p.x - players[my_id].x, 2) +
-                                 powf(p.y - players[my_id].y, 2));
-          float close_distance = 300.0f;
+          float distance = sqrtf(powf(p.x - players.at(my_id).x, 2) +
+                                 powf(p.y - players.at(my_id).y, 2));
+          float close_distance = ASSASSIN_CLOSE_DISTANCE;
 
           if (distance <= close_distance) {
             Vector2 player_center = {(float)p.x + 50, (float)p.y + 50};
@@ -827,16 +1177,9 @@ void draw_players(playermap players, std::vector<Bullet> bullets,
         player_umbrella.is_active = true;
         player_umbrella.draw(res_man, p.x, p.y);
       } else {
-        Color umbrella_tint = WHITE;
-        for (const Bullet &b : bullets) {
-          Rectangle umbrella_rect = {(float)p.x, (float)p.y - 85, 75, 75};
-          Rectangle bullet_rect = {(float)b.x, (float)b.y, (float)b.r * 2,
-                                   (float)b.r * 2};
-          if (CheckCollisionRecs(umbrella_rect, bullet_rect)) {
-            umbrella_tint = RED;
-            break;
-          }
-        }
+        Rectangle umbrella_rect = {(float)p.x, (float)p.y - 85, 75, 75};
+        Color umbrella_tint =
+            aabb_any_hit(umbrella_rect, bullets) ? RED : WHITE;
 
         DrawTexturePro(res_man->getTex("assets/umbrella.png"),
                        {(float)0, (float)0, 16, 16},
@@ -941,13 +1284,51 @@ int clean_sock() {
 }
 
 std::string get_ip_from_args(int argc, char **argv) {
-  if (argc >= 2) {
-    return std::string(argv[1]);
+  for (int i = 1; i < argc; i++) {
+    if (std::strcmp(argv[i], "--interp-delay") == 0 ||
+        std::strcmp(argv[i], "--room") == 0) {
+      i++; // skip the value
+      continue;
+    }
+    if (std::strcmp(argv[i], "--rooms") == 0)
+      continue;
+    return std::string(argv[i]);
   }
 
   return std::string("127.0.0.1");
 }
 
+int get_interp_delay_from_args(int argc, char **argv) {
+  for (int i = 1; i + 1 < argc; i++) {
+    if (std::strcmp(argv[i], "--interp-delay") == 0) {
+      return std::atoi(argv[i + 1]);
+    }
+  }
+
+  return DEFAULT_INTERP_DELAY_MS;
+}
+
+// the lobby: --rooms lists the server's rooms, --room <id> joins one and
+// --room new opens a new one. without them the server picks a room
+void send_lobby_requests(int argc, char **argv) {
+  for (int i = 1; i < argc; i++) {
+    if (std::strcmp(argv[i], "--rooms") == 0) {
+      send_message(netvent::serialize_to_netvent(
+                       netvent::val(MSG_ROOM_LIST_REQUEST),
+                       std::map<std::string, netvent::Value>()),
+                   sock);
+    } else if (std::strcmp(argv[i], "--room") == 0 && i + 1 < argc) {
+      i++;
+      int room = std::strcmp(argv[i], "new") == 0 ? -1 : std::atoi(argv[i]);
+      send_message(netvent::serialize_to_netvent(
+                       netvent::val(MSG_ROOM_JOIN),
+                       std::map<std::string, netvent::Value>(
+                           {{"room", netvent::val(room)}})),
+                   sock);
+    }
+  }
+}
+
 bool switch_weapon(Weapon weapon, Game *game, int my_id, int sock,
                    bool flashlight_usable) {
   if (weapon == Weapon::flashlight && !flashlight_usable) {
@@ -971,6 +1352,8 @@ bool switch_weapon(Weapon weapon, Game *game, int my_id, int sock,
 }
 
 int main(int argc, char **argv) {
+  interp_delay_ms = get_interp_delay_from_args(argc, argv);
+
   if (init_sock() == 1)
     return 1;
 
@@ -985,27 +1368,32 @@ int main(int argc, char **argv) {
     return 1;
   }
 
-  socket_address_in sock_addr;
-  sock_addr.sin_family = ADDRESS_FAMILY_INET;
-  sock_addr.sin_port = host_to_network_short(50000);
-  sock_addr.sin_addr.s_addr = ip_string_to_binary(
+  server_address.sin_family = ADDRESS_FAMILY_INET;
+  server_address.sin_port = host_to_network_short(50000);
+  server_address.sin_addr.s_addr = ip_string_to_binary(
       get_ip_from_args(argc, argv).c_str()); // default to 127.0.0.1 if no arg
 
-  if (connect_socket(sock, (struct sockaddr *)&sock_addr, sizeof(sock_addr)) <
-      0) {
+  if (connect_socket(sock, (struct sockaddr *)&server_address,
+                     sizeof(server_address)) < 0) {
     print_socket_error("Could not connect to server");
 
     close_socket(sock);
     return -1;
   }
+#ifdef SIGPIPE
+  // sends on a dropped connection fail instead of killing us, the recv
+  // thread reconnects
+  std::signal(SIGPIPE, SIG_IGN);
+#endif
 
   std::thread recv_thread(do_recv);
-  SetConfigFlags(FLAG_WINDOW_RESIZABLE);
+  send_resume(sock, "");
+  send_lobby_requests(argc, argv);
+  // no frame cap, gameplay is tied to CLIENT_TICK_MS and not to the refresh rate
+  SetConfigFlags(FLAG_WINDOW_RESIZABLE | FLAG_VSYNC_HINT);
 
   InitWindow(800, 600, "Multi Ludens");
 
-  SetTargetFPS(60);
-
   ResourceManager res_man;
 
   Game game;
@@ -1013,10 +1401,13 @@ int main(int argc, char **argv) {
   g_conf.load();
 
   int my_id = -1;
-  int server_update_counter = 0;
+  int server_update_counter = 0; // ticks since we last sent our movement
   bool hasmoved = false;
-  int bdelay = 20;
+  bool aim_changed = false;
+  int bdelay = FIRE_COOLDOWN_TICKS;
   int canshoot = false;
+  double sim_accumulator_ms = 0;
+  int prev_x = 0, prev_y = 0; // our position one tick ago, for drawing
 
   Color options[5] = {RED, GREEN, YELLOW, PURPLE, ORANGE};
 
@@ -1096,87 +1487,206 @@ int main(int argc, char **argv) {
     // update acid rain
     acid_rain.update(GetFrameTime());
 
-    int cx = game.players[my_id].x;
-    int cy = game.players[my_id].y;
-
-    move_camera(&cam, cx, cy);
-
     if (!usernamechosen) {
       manage_username_prompt(&(game.players), my_id, options, &g_conf);
-      game.players[my_id].username = g_conf.username;
-      game.players[my_id].color = options[g_conf.colorindex];
+      prev_x = game.players[my_id].x;
+      prev_y = game.players[my_id].y;
+      game.players.looks(my_id).username = g_conf.username;
+      game.players.looks(my_id).color = options[g_conf.colorindex];
       usernamechosen = true;
     }
 
-    server_update_counter++;
-
-    can_move_state = update_can_move_state(Rectangle{(float)game.players.at(my_id).x, (float)game.players.at(my_id).y, (float)PLAYER_SIZE, (float)PLAYER_SIZE}, cubes, PLAYER_SIZE, 0.1f, Rectangle{0, 0, (float)PLAYING_AREA.width, (float)PLAYING_AREA.height});
-
-    bool moved = game.players.at(my_id).move(can_move_state);
-
     float scaledWidth = window_size.x * scale;
     float scaledHeight = window_size.y * scale;
     float offsetX = (GetScreenWidth() - scaledWidth) * 0.5f;
     float offsetY = (GetScreenHeight() - scaledHeight) * 0.5f;
-    bool moved_gun = false;
-    if (game.players[my_id].weapon_id == Weapon::gun_or_knife) {
-      moved_gun = move_wpn(&game.players[my_id].rot, cx, cy, cam, scale,
-                           offsetX, offsetY);
-    } else if (game.players[my_id].weapon_id == Weapon::flashlight) {
-      moved_gun = move_flashlight(&game.players[my_id].rot, cx, cy, cam, scale,
-                                  offsetX, offsetY);
+
+    int64_t render_ms = sim_clock.now_ms() - interp_delay_ms;
+    game.update(my_id, sim_clock.tick(), render_ms, chunks);
+
+    // predicted shots step like the real ones, and go away on static
+    // geometry or when the server never confirmed them
+    for (size_t i = 0; i < predicted_shots.size();) {
+      Bullet &b = predicted_shots[i].bullet;
+      bool blocked = false;
+      while (b.tick < sim_clock.tick() && !blocked) {
+        b.step();
+        blocked = bullet_blocked(b, chunks.static_colliders_near(b.x, b.y));
+      }
+      if (blocked ||
+          sim_clock.now_ms() - predicted_shots[i].fired_ms > PREDICTED_SHOT_TIMEOUT_MS) {
+        predicted_shots[i] = predicted_shots.back();
+        predicted_shots.pop_back();
+      } else {
+        i++;
+      }
     }
-    hasmoved = moved || moved_gun;
 
-    if (server_update_counter >= 5 && hasmoved) {
-      std::string msg = netvent::serialize_to_netvent(
-          netvent::val((int)MSG_PLAYER_MOVE),
-          std::map<std::string, netvent::Value>(
-              {{"x", netvent::val(game.players.at(my_id).x)},
-               {"y", netvent::val(game.players.at(my_id).y)},
-               {"rot", netvent::val(game.players.at(my_id).rot)}}));
-      send_message(msg, sock);
+    // pack this frame's bullet and player boxes for the overlap checks below
+    bullet_rects.clear();
+    for (Bullet &b : game.bullets)
+      bullet_rects.push_back(
+          Rectangle{(float)b.x, (float)b.y, (float)b.r * 2, (float)b.r * 2});
+    player_rects.clear();
+    for (const auto &[_, p] : game.players)
+      player_rects.push_back(Rectangle{(float)p.x, (float)p.y,
+                                       (float)PLAYER_SIZE, (float)PLAYER_SIZE});
+
+    // gameplay runs in fixed ticks, however many fit in the time since the
+    // last frame. a long stall is dropped rather than fast-forwarded
+    sim_accumulator_ms += GetFrameTime() * 1000.0;
+    if (sim_accumulator_ms > MAX_FRAME_MS)
+      sim_accumulator_ms = MAX_FRAME_MS;
+    while (sim_accumulator_ms >= CLIENT_TICK_MS) {
+      sim_accumulator_ms -= CLIENT_TICK_MS;
+      Player &me = game.players.at(my_id);
+      prev_x = me.x;
+      prev_y = me.y;
+
+      server_update_counter++;
+
+      update_chunks(me.x, me.y, sim_clock.tick());
+
+      int keys = read_move_keys();
+      bool moved = simulate_move(me, keys, chunks.cube_colliders_near(me.x, me.y));
+
+      if (server_authoritative) {
+        if (moved || aim_changed) {
+          InputCommand cmd;
+          cmd.seq = ++input_seq;
+          cmd.keys = keys;
+          cmd.rot = me.rot;
+          pending_inputs.push_back(cmd);
+          unsent_inputs.push_back(cmd);
+        }
 
-      server_update_counter = 0;
-    }
+        // inputs go out in batches, the server's jitter buffer evens them out
+        if (server_update_counter >= SEND_INTERVAL_TICKS && !unsent_inputs.empty()) {
+          std::vector<netvent::Value> seqs, key_masks, rots;
+          for (const InputCommand &cmd : unsent_inputs) {
+            seqs.push_back(netvent::val(cmd.seq));
+            key_masks.push_back(netvent::val(cmd.keys));
+            rots.push_back(netvent::val(cmd.rot));
+          }
+          std::string msg = netvent::serialize_to_netvent(
+              netvent::val((int)MSG_PLAYER_INPUT),
+              std::map<std::string, netvent::Value>(
+                  {{"seqs", netvent::val(netvent::Table(seqs))},
+                   {"keys", netvent::val(netvent::Table(key_masks))},
+                   {"rots", netvent::val(netvent::Table(rots))}}));
+          send_message(msg, sock);
+
+          unsent_inputs.clear();
+          server_update_counter = 0;
+        }
+      } else {
+        hasmoved = hasmoved || moved || aim_changed;
+        if (server_update_counter >= SEND_INTERVAL_TICKS && hasmoved) {
+          std::string msg = netvent::serialize_to_netvent(
+              netvent::val((int)MSG_PLAYER_MOVE),
+              std::map<std::string, netvent::Value>(
+                  {{"x", netvent::val(me.x)},
+                   {"y", netvent::val(me.y)},
+                   {"rot", netvent::val(me.rot)}}));
+          send_message(msg, sock);
+
+          hasmoved = false;
+          server_update_counter = 0;
+        }
+      }
+      aim_changed = false;
+
+      for (Bullet &b : game.bullets) {
+        b.offset_x *= BULLET_CORRECTION_DECAY;
+        b.offset_y *= BULLET_CORRECTION_DECAY;
+      }
 
-    game.update(my_id, cam);
+      if (!canshoot)
+        bdelay--;
+      if (!canshoot && bdelay == 0) {
+        canshoot = true;
+      }
+
+      if (IsMouseButtonDown(0) && canshoot && me.weapon_id == 0 &&
+          !is_assassin) {
+        canshoot = false;
+        bdelay = FIRE_COOLDOWN_TICKS;
+        float angleRad = (-me.rot + 5) * DEG2RAD;
+        Vector2 spawnOffset =
+            Vector2Scale({cosf(angleRad), -sinf(angleRad)}, -120);
+        Vector2 origin = {(float)me.x + 50, (float)me.y + 50};
+        Vector2 spawnPos = Vector2Add(origin, spawnOffset);
+
+        // draw it now, the server's spawn replaces it
+        int vx, vy;
+        bullet_velocity(me.rot, &vx, &vy);
+        Bullet predicted((int)spawnPos.x, (int)spawnPos.y, vx, vy,
+                         sim_clock.tick(), my_id);
+        predicted.local_id = next_local_bullet_id++;
+        predicted_shots.push_back({predicted, sim_clock.now_ms()});
+
+        // send shot message to server
+        send_message(
+            netvent::serialize_to_netvent(
+                netvent::val((int)MSG_BULLET_SHOT),
+                std::map<std::string, netvent::Value>(
+                    {{"player_id", netvent::val(my_id)},
+                     {"x", netvent::val((int)spawnPos.x)},
+                     {"y", netvent::val((int)spawnPos.y)},
+                     {"rot", netvent::val(me.rot)},
+                     {"local_id", netvent::val(predicted.local_id)},
+                     {"tick", netvent::val(predicted.tick)}})),
+            sock);
+      }
+
+      // update umbrella
+      {
+        Rectangle player_rect = {(float)me.x, (float)me.y, (float)PLAYER_SIZE,
+                                 (float)PLAYER_SIZE};
+
+        // check if player is near barrel
+        for (auto &obj : objects) {
+          if (obj.type == ObjectType::Barrel) {
+            bool is_umbrella_equipped =
+                me.weapon_id == (int)Weapon::umbrella;
+
+            umbrella_usable = player_umbrella.update(
+                obj.bounds, player_rect, bullet_rects, game.bullets,
+                is_umbrella_equipped, CLIENT_TICK_MS / 1000.0f);
 
-    if (!canshoot)
-      bdelay--;
-    if (!canshoot && bdelay == 0) {
-      canshoot = true;
+            break;
+          }
+        }
+
+        if (!umbrella_usable && me.weapon_id == (int)Weapon::umbrella) {
+          switch_weapon(Weapon::gun_or_knife, &game, my_id, sock,
+                        flashlight_usable);
+        }
+      }
     }
 
-    if (IsMouseButtonDown(0) && canshoot &&
-        game.players[my_id].weapon_id == 0 && !is_assassin) {
-      canshoot = false;
-      bdelay = 20;
-      float bspeed = 10;
-      float angleRad = (-game.players[my_id].rot + 5) * DEG2RAD;
-      Vector2 dir = Vector2Scale({cosf(angleRad), -sinf(angleRad)}, -bspeed);
-      Vector2 spawnOffset =
-          Vector2Scale({cosf(angleRad), -sinf(angleRad)}, -120);
-      Vector2 origin = {(float)game.players[my_id].x + 50,
-                        (float)game.players[my_id].y + 50};
-      Vector2 spawnPos = Vector2Add(origin, spawnOffset);
-
-      // send shot message to server
-      send_message(
-          netvent::serialize_to_netvent(
-              netvent::val((int)MSG_BULLET_SHOT),
-              std::map<std::string, netvent::Value>(
-                  {{"player_id", netvent::val(my_id)},
-                   {"x", netvent::val((int)spawnPos.x)},
-                   {"y", netvent::val((int)spawnPos.y)},
-                   {"rot", netvent::val(game.players[my_id].rot)}})),
-          sock);
+    // draw ourselves between the last two ticks so movement stays smooth at
+    // any refresh rate. the simulated position is put back after drawing
+    Player &me = game.players.at(my_id);
+    int sim_x = me.x;
+    int sim_y = me.y;
+    float alpha = (float)(sim_accumulator_ms / CLIENT_TICK_MS);
+
+    int cx = (int)lroundf(Lerp((float)prev_x, (float)sim_x, alpha));
+    int cy = (int)lroundf(Lerp((float)prev_y, (float)sim_y, alpha));
+
+    move_camera(&cam, cx, cy);
+
+    if (me.weapon_id == Weapon::gun_or_knife) {
+      aim_changed |= move_wpn(&me.rot, cx, cy, cam, scale, offsetX, offsetY);
+    } else if (me.weapon_id == Weapon::flashlight) {
+      aim_changed |=
+          move_flashlight(&me.rot, cx, cy, cam, scale, offsetX, offsetY);
     }
 
     // flashlight battery
     {
-      if (game.players[my_id].weapon_id == Weapon::flashlight &&
-          flashlight_usable) {
+      if (me.weapon_id == Weapon::flashlight && flashlight_usable) {
         float deltaTime = GetFrameTime();
         flashlight_time_left -= deltaTime;
 
@@ -1190,8 +1700,7 @@ int main(int argc, char **argv) {
       }
 
       // check charger coil
-      if (check_charging_station_collision(game.players[my_id].x,
-                                           game.players[my_id].y)) {
+      if (check_charging_station_collision(me.x, me.y)) {
         flashlight_usable = true;
         flashlight_time_left = 15.0f; // Reset to full battery
       }
@@ -1200,7 +1709,7 @@ int main(int argc, char **argv) {
     // detect weapon switching with keyboard keys
     {
       bool weapon_changed = false;
-      Weapon currentWeapon = (Weapon)game.players[my_id].weapon_id;
+      Weapon currentWeapon = (Weapon)me.weapon_id;
 
       if (IsKeyPressed(KEY_ONE)) {
         currentWeapon = Weapon::gun_or_knife;
@@ -1218,41 +1727,8 @@ int main(int argc, char **argv) {
       }
     }
 
-    // update umbrella
-    {
-      Rectangle player_rect = {(float)game.players[my_id].x,
-                               (float)game.players[my_id].y, (float)PLAYER_SIZE,
-                               (float)PLAYER_SIZE};
-      std::vector<Rectangle> bullets_rects;
-      std::vector<Bullet> active_bullets;
-
-      for (Bullet &b : game.bullets) {
-        bullets_rects.push_back(
-            Rectangle{(float)b.x, (float)b.y, (float)b.r * 2, (float)b.r * 2});
-        active_bullets.push_back(b);
-      }
-
-      // check if player is near barrel
-      for (auto &obj : objects) {
-        if (obj.type == ObjectType::Barrel) {
-          bool near_barrel = obj.check_collision(player_rect);
-          bool is_umbrella_equipped =
-              game.players[my_id].weapon_id == (int)Weapon::umbrella;
-
-          umbrella_usable =
-              player_umbrella.update(obj.bounds, player_rect, bullets_rects,
-                                     active_bullets, is_umbrella_equipped);
-
-          break;
-        }
-      }
-
-      if (!umbrella_usable &&
-          game.players[my_id].weapon_id == (int)Weapon::umbrella) {
-        switch_weapon(Weapon::gun_or_knife, &game, my_id, sock,
-                      flashlight_usable);
-      }
-    }
+    me.x = cx;
+    me.y = cy;
 
     // draw to render texture
     BeginTextureMode(target);
@@ -1260,13 +1736,24 @@ int main(int argc, char **argv) {
 
     BeginMode2D(cam);
 
-    // Draw floor tiles based on PLAYING_AREA
-    for (int i = 0; i < PLAYING_AREA.width / TILE_SIZE; i++) {
-      for (int j = 0; j < PLAYING_AREA.height / TILE_SIZE; j++) {
-        if (isInViewport(i * TILE_SIZE, j * TILE_SIZE, TILE_SIZE, TILE_SIZE,
-                         cam))
-          DrawTexture(res_man.getTex("assets/floor_tile.png"), i * TILE_SIZE,
-                      j * TILE_SIZE, WHITE);
+    // Draw the floor tiles the camera sees
+    {
+      // same viewport as isInViewport
+      float view_x = cam.target.x - cam.offset.x / cam.zoom;
+      float view_y = cam.target.y - cam.offset.y / cam.zoom;
+      int first_i = std::max(0, (int)(view_x / TILE_SIZE));
+      int first_j = std::max(0, (int)(view_y / TILE_SIZE));
+      int last_i = std::min((int)(PLAYING_AREA.width / TILE_SIZE) - 1,
+                            (int)((view_x + window_size.x / cam.zoom) / TILE_SIZE));
+      int last_j = std::min((int)(PLAYING_AREA.height / TILE_SIZE) - 1,
+                            (int)((view_y + window_size.y / cam.zoom) / TILE_SIZE));
+      for (int i = first_i; i <= last_i; i++) {
+        for (int j = first_j; j <= last_j; j++) {
+          if (isInViewport(i * TILE_SIZE, j * TILE_SIZE, TILE_SIZE, TILE_SIZE,
+                           cam))
+            DrawTexture(res_man.getTex("assets/floor_tile.png"), i * TILE_SIZE,
+                        j * TILE_SIZE, WHITE);
+        }
       }
     }
 
@@ -1282,20 +1769,17 @@ int main(int argc, char **argv) {
       }
     }
 
-    // draw cubes
-    cube_loop(cubes, cam, &res_man);
+    // draw the cubes of the chunks on screen
+    for (auto &[key, chunk] : chunks) {
+      Rectangle area = chunk_area(chunk.x, chunk.y);
+      if (isInViewport(area.x, area.y, area.width, area.height, cam))
+        cube_loop(chunk.cubes, cam, &res_man);
+    }
 
     // draw umbrella barrel
     // if any player is touching the barrel, tint it green
-    Color barrel_tint = WHITE;
-    for (const auto &[_, p] : game.players) {
-      Rectangle player_rect = {(float)p.x, (float)p.y, (float)PLAYER_SIZE,
-                               (float)PLAYER_SIZE};
-      if (CheckCollisionRecs(umbrella_barrel, player_rect)) {
-        barrel_tint = GREEN;
-        break;
-      }
-    }
+    Color barrel_tint =
+        aabb_any_hit(umbrella_barrel, player_rects) ? GREEN : WHITE;
 
     Color shadow_color = {0, 0, 0, 80};
     float shadow_width = 80;
@@ -1311,10 +1795,19 @@ int main(int argc, char **argv) {
                     BARREL_SIZE},
                    {0, 0}, 0.0f, barrel_tint);
 
-    draw_players(game.players, game.bullets, &res_man, my_id);
+    draw_players(game.players, bullet_rects, &res_man, my_id);
 
-    for (Bullet &b : game.bullets)
-      b.show();
+    // other players' bullets at the same delayed time as the players, so
+    // they leave the shooter's gun instead of appearing ahead of it
+    double render_tick = (double)render_ms * SIM_TICK_RATE / 1000;
+    for (Bullet &b : game.bullets) {
+      if (b.shotby_id == my_id)
+        b.show();
+      else if (render_tick >= b.spawn_tick)
+        b.show_at(b.position_at(render_tick));
+    }
+    for (PredictedShot &shot : predicted_shots)
+      shot.bullet.show();
 
     // Draw acid rain effect
     acid_rain.draw(game.players);
@@ -1410,7 +1903,7 @@ int main(int argc, char **argv) {
     }
 
     BeginTextureMode(target);
-    draw_ui(my_true_color, game.players, game.bullets, my_id, (20 - bdelay),
+    draw_ui(my_true_color, game.players, my_id, (FIRE_COOLDOWN_TICKS - bdelay),
             cam, scale);
     EndTextureMode();
 
@@ -1425,6 +1918,9 @@ int main(int argc, char **argv) {
     DrawTexturePro(target.texture, source, dest, Vector2{0, 0}, 0.0f, WHITE);
 
     EndDrawing();
+
+    me.x = sim_x;
+    me.y = sim_y;
   }
 
   // Cleanup
@@ -10,4 +10,16 @@ inline const int MSG_BULLET_SHOT = 10;       // changed
 inline const int MSG_EVENT_SUMMON = 11;      // changed
 inline const int MSG_SWITCH_WEAPON = 12;     // changed
 inline const int MSG_ASSASSIN_CHANGE = 15;   // changed
-inline const int MSG_BULLET_DESPAWN = 16;    // changed
\ No newline at end of file
+inline const int MSG_BULLET_BATCH = 17;
+inline const int MSG_SNAPSHOT = 18;
+inline const int MSG_SNAPSHOT_ACK = 19;
+inline const int MSG_PLAYER_INPUT = 20;
+inline const int MSG_MAP_REQUEST = 21;
+inline const int MSG_MAP_CUBES = 22;
+inline const int MSG_CHUNK_REQUEST = 23;
+inline const int MSG_CHUNK = 24;
+inline const int MSG_ROOM_LIST_REQUEST = 25;
+inline const int MSG_ROOM_LIST = 26;
+inline const int MSG_ROOM_JOIN = 27;
+inline const int MSG_RESUME = 28;
+inline const int MSG_RESUMED = 29;
@@ -1,4 +1,5 @@
 #pragma once
+#include "aabb.hpp"
 #include "constants.hpp"
 #include "player.hpp"
 #include "objects.hpp"
@@ -12,30 +13,38 @@ struct CanMoveState {
 };
 
 
-inline CanMoveState update_can_move_state(Rectangle player, std::vector<Object> cubes, const int PLAYER_SIZE = 50, const float move_amount = 1.0f, Rectangle playing_area = {0, 0, 800, 600})
+// movement colliders are the cube bounds shifted up by their height
+inline Rectangle cube_move_collider(const Object &cube)
+{
+    return {cube.bounds.x, cube.bounds.y - cube.bounds.height, cube.bounds.width, cube.bounds.height};
+}
+
+inline AabbBatch cube_move_colliders(const std::vector<Object> &cubes)
+{
+    AabbBatch colliders;
+    colliders.reserve(cubes.size());
+    for (const auto &cube : cubes) {
+        colliders.push_back(cube_move_collider(cube));
+    }
+    return colliders;
+}
+
+inline CanMoveState update_can_move_state(Rectangle player, const AabbBatch &cube_colliders, const int PLAYER_SIZE = 50, const float move_amount = 1.0f, Rectangle playing_area = {0, 0, 800, 600})
 {
     CanMoveState new_can_move_state = {true, true, true, true};
     
-    // cube collisions
-    for (auto &cube : cubes) {
-        Rectangle cube_correct_bounds = {cube.bounds.x, cube.bounds.y - cube.bounds.height, cube.bounds.width, cube.bounds.height};
-        // up
-        if (CheckCollisionRecs(Rectangle{player.x, player.y - move_amount, (float)PLAYER_SIZE, (float)PLAYER_SIZE}, cube_correct_bounds)) {
-            new_can_move_state.up = false;
-        }
-        // down
-        if (CheckCollisionRecs(Rectangle{player.x, player.y + move_amount, (float)PLAYER_SIZE, (float)PLAYER_SIZE}, cube_correct_bounds)) {
-            new_can_move_state.down = false;
-        }
-        // left
-        if (CheckCollisionRecs(Rectangle{player.x - move_amount, player.y, (float)PLAYER_SIZE, (float)PLAYER_SIZE}, cube_correct_bounds)) {
-            new_can_move_state.left = false;
-        }
-        // right
-        if (CheckCollisionRecs(Rectangle{player.x + move_amount, player.y, (float)PLAYER_SIZE, (float)PLAYER_SIZE}, cube_correct_bounds)) {
-            new_can_move_state.right = false;
-        }
-    }
+    // cube collisions (up, down, left, right probes in one pass)
+    Rectangle probes[4] = {
+        {player.x, player.y - move_amount, (float)PLAYER_SIZE, (float)PLAYER_SIZE},
+        {player.x, player.y + move_amount, (float)PLAYER_SIZE, (float)PLAYER_SIZE},
+        {player.x - move_amount, player.y, (float)PLAYER_SIZE, (float)PLAYER_SIZE},
+        {player.x + move_amount, player.y, (float)PLAYER_SIZE, (float)PLAYER_SIZE}
+    };
+    uint32_t blocked = aabb_probe_mask(probes, 4, cube_colliders);
+    if (blocked & 1) new_can_move_state.up = false;
+    if (blocked & 2) new_can_move_state.down = false;
+    if (blocked & 4) new_can_move_state.left = false;
+    if (blocked & 8) new_can_move_state.right = false;
 
     // playing area collisions
     if (player.x - move_amount < playing_area.x) {
@@ -5,8 +5,14 @@
 
 const int TILE_SIZE = 100;
 const int UMBRELLA_HIT_LIMIT = 2;
+// default world size, the server can pick another (--world-tiles) and
+// sends it to clients on join
 const int PLAYING_AREA_TILES = 10;
-const Rectangle PLAYING_AREA = {0, 0, TILE_SIZE *PLAYING_AREA_TILES,
-                                TILE_SIZE *PLAYING_AREA_TILES};
+inline Rectangle PLAYING_AREA = {0, 0, TILE_SIZE *PLAYING_AREA_TILES,
+                                 TILE_SIZE *PLAYING_AREA_TILES};
+
+inline void set_playing_area_tiles(int tiles) {
+  PLAYING_AREA = {0, 0, (float)(TILE_SIZE * tiles), (float)(TILE_SIZE * tiles)};
+}
 
 #endif
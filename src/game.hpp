@@ -2,7 +2,9 @@
 #include "bullet.hpp"
 #include "constants.hpp"
 #include "raylib.h"
+#include "slot_map.hpp"
 #include "utils.hpp"
+#include "world.hpp"
 #include <algorithm>
 #include <vector>
 
@@ -10,35 +12,43 @@
 class Game {
 public:
   playermap players;
-  std::vector<Bullet> bullets;
+  SlotMap<Bullet> bullets;
 
-  void update_bullets(Camera2D cam, int my_id) {
-    for (Bullet &b : this->bullets) {
-      b.move();
+  // steps every bullet up to tick, dropping the ones that hit static geometry
+  // in the loaded chunks. player hits are left to the server
+  void update_bullets(int tick, const ChunkMap &map) {
+    size_t i = 0;
+    while (i < this->bullets.size()) {
+      Bullet &b = this->bullets.dense_at(i);
+      bool blocked = false;
+      while (b.tick < tick && !blocked) {
+        b.step();
+        blocked = bullet_blocked(b, map.static_colliders_near(b.x, b.y));
+      }
+      if (blocked)
+        this->bullets.erase_dense(i);
+      else
+        i++;
     }
   }
 
-  void update_players(int skip) {
+  // remote players go where the server had them at render_ms
+  void update_players(int skip, int64_t render_ms) {
+    size_t index = 0;
     for (auto &[k, v] : this->players) {
+      InterpolationBuffer &motion = this->players.motion_at(index++);
       if (k == skip)
         continue;
-      if (v.x != v.nx) {
-        if (v.x < v.nx)
-          v.x += v.speed;
-        if (v.x > v.nx)
-          v.x -= v.speed;
-      }
-      if (v.y != v.ny) {
-        if (v.y < v.ny)
-          v.y += v.speed;
-        if (v.y > v.ny)
-          v.y -= v.speed;
+      float x, y;
+      if (motion.sample(render_ms, &x, &y)) {
+        v.x = (int)lroundf(x);
+        v.y = (int)lroundf(y);
       }
     }
   }
 
-  void update(int skip, Camera2D cam) {
-    this->update_players(skip);
-    this->update_bullets(cam, skip);
+  void update(int skip, int tick, int64_t render_ms, const ChunkMap &map) {
+    this->update_players(skip, render_ms);
+    this->update_bullets(tick, map);
   }
 };
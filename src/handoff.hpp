@@ -0,0 +1,198 @@
+#pragma once
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if __unix__
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+// hot restart (--handoff <path>): a new server started with the same path
+// connects to the running one there, which stops at the end of a tick and
+// passes it the listening socket, every client socket (SCM_RIGHTS) and the
+// game state. players keep their connection, the old process exits.
+//
+// the channel is a SOCK_SEQPACKET unix socket, so every record is one
+// message with its own boundaries: a netvent message (or raw bytes) and at
+// most one descriptor
+
+// record types, the netvent event of each message
+const int HANDOFF_REQUEST = 1;    // new -> old, asks for everything
+const int HANDOFF_SERVER = 2;     // the listener (fd), clock and settings
+const int HANDOFF_ROOM = 3;       // a room: map seed, events, assassin
+const int HANDOFF_PLAYER = 4;     // a player of a room and its resume token
+const int HANDOFF_BULLET = 5;     // a bullet in flight
+const int HANDOFF_CONNECTION = 6; // a player's socket (fd), raw pending bytes follow
+const int HANDOFF_END = 7;
+const int HANDOFF_DONE = 8;       // new -> old, everything adopted
+
+// how long either side waits on the other before giving up
+const int HANDOFF_TIMEOUT_MS = 5000;
+// room for the largest record (a room with its assassin history)
+const int HANDOFF_MAX_RECORD = 256 * 1024;
+
+#if __unix__
+
+inline bool handoff_address(const std::string &path, sockaddr_un *addr) {
+  std::memset(addr, 0, sizeof(*addr));
+  addr->sun_family = AF_UNIX;
+  if (path.size() >= sizeof(addr->sun_path)) {
+    std::cerr << "Handoff path too long: " << path << std::endl;
+    return false;
+  }
+  std::memcpy(addr->sun_path, path.c_str(), path.size());
+  return true;
+}
+
+inline void handoff_set_timeout(int sock, int ms) {
+  timeval tv;
+  tv.tv_sec = ms / 1000;
+  tv.tv_usec = (ms % 1000) * 1000;
+  setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+  setsockopt(sock, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+}
+
+// where the running server waits for its successor. replaces a stale
+// socket file, so call it only after taking over (or finding nobody there)
+inline int handoff_listen(const std::string &path) {
+  sockaddr_un addr;
+  if (!handoff_address(path, &addr))
+    return -1;
+  int sock = socket(AF_UNIX, SOCK_SEQPACKET, 0);
+  if (sock < 0) {
+    perror("Failed to create handoff socket");
+    return -1;
+  }
+  unlink(path.c_str());
+  if (bind(sock, (sockaddr *)&addr, sizeof(addr)) < 0 || listen(sock, 1) < 0) {
+    perror("Failed to listen for handoffs");
+    close(sock);
+    return -1;
+  }
+  return sock;
+}
+
+// the running server at path, -1 if there is none
+inline int handoff_connect(const std::string &path) {
+  sockaddr_un addr;
+  if (!handoff_address(path, &addr))
+    return -1;
+  int sock = socket(AF_UNIX, SOCK_SEQPACKET, 0);
+  if (sock < 0)
+    return -1;
+  if (connect(sock, (sockaddr *)&addr, sizeof(addr)) < 0) {
+    close(sock);
+    return -1;
+  }
+  handoff_set_timeout(sock, HANDOFF_TIMEOUT_MS);
+  return sock;
+}
+
+inline bool handoff_send(int sock, const std::string &record, int fd = -1) {
+  iovec iov;
+  iov.iov_base = const_cast<char *>(record.data());
+  iov.iov_len = record.size();
+
+  msghdr msg;
+  std::memset(&msg, 0, sizeof(msg));
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+
+  alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))];
+  if (fd != -1) {
+    std::memset(control, 0, sizeof(control));
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+    std::memcpy(CMSG_DATA(cmsg), &fd, sizeof(int));
+  }
+
+  ssize_t sent;
+  do {
+    sent = sendmsg(sock, &msg, MSG_NOSIGNAL);
+  } while (sent < 0 && errno == EINTR);
+  return sent == (ssize_t)record.size();
+}
+
+// the next record. *fd is the descriptor that came with it, or -1
+inline bool handoff_recv(int sock, std::string *record, int *fd) {
+  record->resize(HANDOFF_MAX_RECORD);
+  iovec iov;
+  iov.iov_base = &(*record)[0];
+  iov.iov_len = record->size();
+
+  msghdr msg;
+  std::memset(&msg, 0, sizeof(msg));
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))];
+  msg.msg_control = control;
+  msg.msg_controllen = sizeof(control);
+
+  ssize_t received;
+  do {
+    received = recvmsg(sock, &msg, MSG_CMSG_CLOEXEC);
+  } while (received < 0 && errno == EINTR);
+
+  *fd = -1;
+  for (cmsghdr *cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+    if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS)
+      std::memcpy(fd, CMSG_DATA(cmsg), sizeof(int));
+  }
+  if (received <= 0 || (msg.msg_flags & (MSG_TRUNC | MSG_CTRUNC))) {
+    if (*fd != -1)
+      close(*fd);
+    *fd = -1;
+    return false;
+  }
+  record->resize(received);
+  return true;
+}
+
+// blocking calls the handoff has to interrupt (accept, recv on client
+// sockets) are woken with this signal. it does nothing itself, the call
+// just returns EINTR and the thread checks why
+const int HANDOFF_WAKE_SIGNAL = SIGUSR1;
+
+inline void handoff_init_wake_signal() {
+  struct sigaction action;
+  std::memset(&action, 0, sizeof(action));
+  action.sa_handler = [](int) {};
+  sigemptyset(&action.sa_mask);
+  action.sa_flags = 0; // no SA_RESTART, the call has to come back
+  sigaction(HANDOFF_WAKE_SIGNAL, &action, nullptr);
+}
+
+inline void handoff_wake(std::thread &thread) {
+  pthread_kill(thread.native_handle(), HANDOFF_WAKE_SIGNAL);
+}
+
+#else
+
+inline void handoff_set_timeout(int, int) {}
+inline int handoff_listen(const std::string &) {
+  std::cerr << "--handoff needs unix sockets, hot restart is off" << std::endl;
+  return -1;
+}
+inline int handoff_connect(const std::string &) { return -1; }
+inline bool handoff_send(int, const std::string &, int = -1) { return false; }
+inline bool handoff_recv(int, std::string *, int *fd) {
+  *fd = -1;
+  return false;
+}
+inline void handoff_init_wake_signal() {}
+inline void handoff_wake(std::thread &) {}
+
+#endif
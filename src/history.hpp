@@ -0,0 +1,59 @@
+#pragma once
+#include "aabb.hpp"
+#include "utils.hpp"
+#include <algorithm>
+#include <vector>
+
+// player hitboxes for each of the last HISTORY_TICKS sim ticks, so hit checks
+// can look at the world the way a lagging shooter saw it. frames are packed
+// like the live colliders and reuse their storage, so memory stays around
+// HISTORY_TICKS * players * 20 bytes (about 64 KB for 50 players)
+const int HISTORY_TICKS = 64;
+
+struct HistoryFrame {
+  int tick = -1;
+  AabbBatch boxes;
+  std::vector<int> ids;
+};
+
+class PositionHistory {
+public:
+  // stores the current hitboxes for every tick since the last call up to
+  // tick (the current tick is rewritten, players may have moved within it)
+  void record(int tick, const playermap &players) {
+    int from = tick;
+    if (last_tick != -1 && tick - last_tick <= HISTORY_TICKS)
+      from = last_tick + 1 < tick ? last_tick + 1 : tick;
+    else
+      first_tick = tick; // nothing before this is kept
+
+    for (int t = from; t <= tick; t++) {
+      HistoryFrame &frame = frames[t % HISTORY_TICKS];
+      frame.tick = t;
+      frame.boxes.clear();
+      frame.ids.clear();
+      for (const auto &[id, p] : players) {
+        frame.boxes.push_back({(float)p.x, (float)p.y, 100, 100});
+        frame.ids.push_back(id);
+      }
+    }
+    if (tick > last_tick)
+      last_tick = tick;
+  }
+
+  // the frame at tick, clamped to the ticks still kept (an empty frame
+  // before the first record)
+  const HistoryFrame &at(int tick) const {
+    if (last_tick < 0)
+      return frames[0];
+    int oldest = std::max(first_tick, last_tick - HISTORY_TICKS + 1);
+    tick = std::clamp(tick, oldest, last_tick);
+    const HistoryFrame &frame = frames[tick % HISTORY_TICKS];
+    return frame.tick == tick ? frame : frames[last_tick % HISTORY_TICKS];
+  }
+
+private:
+  HistoryFrame frames[HISTORY_TICKS];
+  int first_tick = 0;
+  int last_tick = -1;
+};
@@ -0,0 +1,71 @@
+#pragma once
+#include "constants.hpp"
+#include "drawScale.hpp"
+#include <cmath>
+#include <raylib.h>
+#include <raymath.h>
+
+// how much of another player's movement a client needs
+enum Interest {
+  INTEREST_NONE = 0,   // can't see them at all
+  INTEREST_COARSE = 1, // minimap dot only, quantized and rate limited
+  INTEREST_FULL = 2    // on screen, every move
+};
+
+// slack around the view so players don't pop in at the edge
+const float INTEREST_MARGIN = 150.0f;
+// the minimap is 100px for the whole playing area, finer than this is wasted
+inline int coarse_cell() { return (int)(PLAYING_AREA.width / 100); }
+const int COARSE_INTERVAL_MS = 250;
+// an invisible assassin's knife shows up within this distance
+const float ASSASSIN_CLOSE_DISTANCE = 300.0f;
+// radius of a player's own light during darkness
+const float DARKNESS_LIGHT_RADIUS = 200.0f;
+
+// world rect a client at (x, y) can see (same clamping as the client camera)
+inline Rectangle view_region(int x, int y) {
+  float cx = Clamp(x + 50.0f, window_size.x / 2, PLAYING_AREA.width - window_size.x / 2);
+  float cy = Clamp(y + 50.0f, window_size.y / 2, PLAYING_AREA.height - window_size.y / 2);
+  return Rectangle{cx - window_size.x / 2 - INTEREST_MARGIN,
+                   cy - window_size.y / 2 - INTEREST_MARGIN,
+                   window_size.x + INTEREST_MARGIN * 2,
+                   window_size.y + INTEREST_MARGIN * 2};
+}
+
+inline float player_distance(int ax, int ay, int bx, int by) {
+  float dx = (float)(ax - bx);
+  float dy = (float)(ay - by);
+  return sqrtf(dx * dx + dy * dy);
+}
+
+// what the viewer needs to know about the subject. mirrors what the client
+// actually draws: invisible players only as a knife up close, and in the dark
+// only what a light reaches (plus flashlight holders on the minimap)
+inline Interest player_interest(int viewer_x, int viewer_y, bool viewer_has_light,
+                                bool viewer_is_assassin, int subject_x,
+                                int subject_y, bool subject_invisible,
+                                bool subject_has_light, bool darkness) {
+  float distance = player_distance(viewer_x, viewer_y, subject_x, subject_y);
+
+  if (subject_invisible) {
+    return distance <= ASSASSIN_CLOSE_DISTANCE + INTEREST_MARGIN ? INTEREST_FULL
+                                                                 : INTEREST_NONE;
+  }
+
+  Rectangle subject = {(float)subject_x, (float)subject_y, 100, 100};
+  bool in_view = CheckCollisionRecs(view_region(viewer_x, viewer_y), subject);
+
+  if (!darkness || viewer_is_assassin) {
+    return in_view ? INTEREST_FULL : INTEREST_COARSE;
+  }
+
+  if (in_view && (viewer_has_light || subject_has_light ||
+                  distance <= DARKNESS_LIGHT_RADIUS + INTEREST_MARGIN)) {
+    return INTEREST_FULL;
+  }
+  // lit by someone else's flashlight maybe, keep a rough position
+  if (in_view || subject_has_light) {
+    return INTEREST_COARSE;
+  }
+  return INTEREST_NONE;
+}
@@ -0,0 +1,89 @@
+#pragma once
+#include <cstdint>
+
+// how far behind the server clock remote entities are drawn. two snapshot
+// intervals, so one late snapshot still leaves a state on either side
+const int DEFAULT_INTERP_DELAY_MS = 100;
+// past the newest state keep going at the last velocity this long, then stop
+const int MAX_EXTRAPOLATE_MS = 100;
+// a jump this big between two states is a teleport, not movement
+const float INTERP_SNAP_DISTANCE = 300.0f;
+
+struct TimedPosition {
+  int64_t time_ms = 0;
+  float x = 0, y = 0;
+};
+
+// the last few server positions of one entity, sampled at a render time
+class InterpolationBuffer {
+public:
+  static const int SIZE = 8;
+
+  void push(int64_t time_ms, float x, float y) {
+    if (count > 0) {
+      TimedPosition &last = states[head];
+      if (time_ms < last.time_ms)
+        return; // older than what we have
+      if (time_ms == last.time_ms) {
+        last.x = x;
+        last.y = y;
+        return;
+      }
+      float dx = x - last.x, dy = y - last.y;
+      if (dx * dx + dy * dy > INTERP_SNAP_DISTANCE * INTERP_SNAP_DISTANCE)
+        count = 0;
+    }
+    head = (head + 1) % SIZE;
+    states[head] = {time_ms, x, y};
+    if (count < SIZE)
+      count++;
+  }
+
+  // position at render_ms, false if nothing was pushed yet
+  bool sample(int64_t render_ms, float *x, float *y) const {
+    if (count == 0)
+      return false;
+
+    const TimedPosition &newest = at(0);
+    if (render_ms >= newest.time_ms) {
+      if (count == 1) {
+        *x = newest.x;
+        *y = newest.y;
+        return true;
+      }
+      const TimedPosition &prev = at(1);
+      int64_t ahead = render_ms - newest.time_ms;
+      if (ahead > MAX_EXTRAPOLATE_MS)
+        ahead = MAX_EXTRAPOLATE_MS;
+      float t = (float)ahead / (float)(newest.time_ms - prev.time_ms);
+      *x = newest.x + (newest.x - prev.x) * t;
+      *y = newest.y + (newest.y - prev.y) * t;
+      return true;
+    }
+
+    for (int i = 1; i < count; i++) {
+      const TimedPosition &older = at(i);
+      if (older.time_ms <= render_ms) {
+        const TimedPosition &newer = at(i - 1);
+        float t = (float)(render_ms - older.time_ms) /
+                  (float)(newer.time_ms - older.time_ms);
+        *x = older.x + (newer.x - older.x) * t;
+        *y = older.y + (newer.y - older.y) * t;
+        return true;
+      }
+    }
+
+    // further back than we remember
+    *x = at(count - 1).x;
+    *y = at(count - 1).y;
+    return true;
+  }
+
+private:
+  TimedPosition states[SIZE];
+  int head = 0;
+  int count = 0;
+
+  // i states before the newest
+  const TimedPosition &at(int i) const { return states[(head - i + SIZE) % SIZE]; }
+};
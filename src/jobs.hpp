@@ -0,0 +1,168 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// small work-stealing job pool. every thread has its own deque: the owner
+// pushes and pops at the back (newest first, still warm in cache), idle
+// threads steal from the front of someone else's.
+//
+// the only entry point is parallel_for, a fork-join: it splits a range into
+// chunks, helps run them and returns once all are done. results should go
+// into per-index slots and be merged by the caller afterwards, so the outcome
+// doesn't depend on which thread ran what
+class JobSystem {
+public:
+  typedef std::function<void(size_t begin, size_t end)> RangeFn;
+
+  ~JobSystem() { stop(); }
+
+  // threads counts the caller, so start(1) (or never starting) runs
+  // everything inline. outside is how many non-worker threads fork, each
+  // gets its own queue and has to attach() to it first (slot 0 needs not)
+  void start(unsigned threads, unsigned outside = 1) {
+    if (threads < 1)
+      threads = 1;
+    if (outside < 1)
+      outside = 1;
+    outside_count = outside;
+    for (unsigned i = 0; i < outside + threads - 1; i++)
+      queues.push_back(std::make_unique<Queue>());
+    for (unsigned i = outside; i < queues.size(); i++)
+      workers.emplace_back([this, i] { work(i); });
+  }
+
+  // binds the calling outside thread to its slot in [0, outside)
+  void attach(unsigned slot) { thread_queue() = (int)slot; }
+
+  void stop() {
+    {
+      std::lock_guard<std::mutex> lock(wake_mutex);
+      stopping = true;
+    }
+    wake.notify_all();
+    for (std::thread &t : workers)
+      t.join();
+    workers.clear();
+  }
+
+  unsigned thread_count() const { return (unsigned)workers.size() + 1; }
+
+  // runs fn over [0, count) in chunks of at least grain items
+  void parallel_for(size_t count, size_t grain, const RangeFn &fn) {
+    if (count == 0)
+      return;
+    if (grain < 1)
+      grain = 1;
+    if (workers.empty() || count <= grain) {
+      fn(0, count);
+      return;
+    }
+
+    // a few chunks per thread so stealing can even out uneven ones
+    size_t chunks = thread_count() * 4;
+    size_t chunk = (count + chunks - 1) / chunks;
+    if (chunk < grain)
+      chunk = grain;
+
+    size_t jobs = (count + chunk - 1) / chunk;
+    std::atomic<size_t> pending(jobs);
+    {
+      // under the wake lock so a worker can't miss it between its check
+      // and going to sleep
+      std::lock_guard<std::mutex> lock(wake_mutex);
+      queued += jobs;
+    }
+    int self = current_queue();
+    {
+      std::lock_guard<std::mutex> lock(queues[self]->mutex);
+      for (size_t begin = 0; begin < count; begin += chunk) {
+        size_t end = begin + chunk < count ? begin + chunk : count;
+        queues[self]->jobs.push_back({[&fn, begin, end] { fn(begin, end); }, &pending});
+      }
+    }
+    wake.notify_all();
+
+    // help out until our chunks are done, wherever they ended up
+    while (pending.load() != 0) {
+      if (!run_one(self))
+        std::this_thread::yield();
+    }
+  }
+
+private:
+  struct Job {
+    std::function<void()> fn;
+    std::atomic<size_t> *pending;
+  };
+  struct Queue {
+    std::mutex mutex;
+    std::deque<Job> jobs;
+  };
+
+  // the first outside_count are for outside threads, then one per worker
+  std::vector<std::unique_ptr<Queue>> queues;
+  unsigned outside_count = 1;
+  std::vector<std::thread> workers;
+  std::mutex wake_mutex;
+  std::condition_variable wake;
+  std::atomic<size_t> queued{0}; // jobs pushed and not yet picked up
+  bool stopping = false;
+
+  static int &thread_queue() {
+    static thread_local int index = 0;
+    return index;
+  }
+
+  // every outside thread forks on its own queue (the server tick on 0, the
+  // replication thread on 1), nested forks from jobs use the worker's own
+  int current_queue() const { return thread_queue(); }
+
+  bool pop(int q, bool steal, Job *job) {
+    std::lock_guard<std::mutex> lock(queues[q]->mutex);
+    std::deque<Job> &jobs = queues[q]->jobs;
+    if (jobs.empty())
+      return false;
+    if (steal) {
+      *job = std::move(jobs.front());
+      jobs.pop_front();
+    } else {
+      *job = std::move(jobs.back());
+      jobs.pop_back();
+    }
+    return true;
+  }
+
+  // outside threads only help with their own chunks, so the tick never ends
+  // up running snapshot jobs or the other way round. workers steal anything
+  bool run_one(int self) {
+    Job job;
+    bool found = pop(self, false, &job);
+    for (size_t k = 1; !found && self >= (int)outside_count && k < queues.size(); k++)
+      found = pop((int)((self + k) % queues.size()), true, &job);
+    if (!found)
+      return false;
+    queued.fetch_sub(1);
+    job.fn();
+    job.pending->fetch_sub(1);
+    return true;
+  }
+
+  void work(int index) {
+    thread_queue() = index;
+    while (true) {
+      if (run_one(index))
+        continue;
+      std::unique_lock<std::mutex> lock(wake_mutex);
+      wake.wait(lock, [this] { return stopping || queued.load() != 0; });
+      if (stopping)
+        return;
+    }
+  }
+};
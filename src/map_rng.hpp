@@ -0,0 +1,38 @@
+#pragma once
+#include <cstdint>
+#include <utility>
+
+// deterministic PRNG (splitmix64) for whatever server and clients have to
+// generate identically, like the map. fixed width integer math only, so the
+// sequence is the same on every compiler and platform, unlike rand() or
+// raylib's GetRandomValue
+class MapRng {
+public:
+  explicit MapRng(uint64_t seed) : state(seed) {}
+
+  uint32_t next() {
+    uint64_t z = (state += 0x9e3779b97f4a7c15ull);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return (uint32_t)((z ^ (z >> 31)) >> 32);
+  }
+
+  // uniform in [min, max], both included like GetRandomValue
+  int range(int min, int max) {
+    if (min > max)
+      std::swap(min, max);
+    uint32_t span = (uint32_t)((int64_t)max - min + 1);
+    if (span == 0)
+      return (int)next(); // the whole int range
+    // drop the partial bucket at the top so no value is more likely
+    uint32_t limit = UINT32_MAX - UINT32_MAX % span;
+    uint32_t r;
+    do {
+      r = next();
+    } while (r >= limit);
+    return (int)((int64_t)min + r % span);
+  }
+
+private:
+  uint64_t state;
+};
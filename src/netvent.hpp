@@ -380,6 +380,13 @@ inline std::string serialize_to_netvent(const Value& event_name, const std::map<
     return ss.str();
 }
 
+// one key with an already serialized value, appended to a message from
+// serialize_to_netvent. lets a sender keep the text of fields that rarely
+// change instead of rebuilding them every time
+inline std::string serialized_field(const std::string& key, const std::string& value) {
+    return key + " " + value + "\n";
+}
+
 inline std::pair<Value, std::map<std::string, Value>> deserialize_from_netvent(std::string data) {
     std::map<std::string, Value> result;
     std::stringstream ss(data);
@@ -10,6 +10,7 @@
 #include <arpa/inet.h>
 #include <netinet/in.h>
 #include <sys/socket.h>
+#include <sys/time.h>
 #include <unistd.h>
 #include <cerrno>
 #include <cstring>
@@ -182,6 +183,21 @@ inline int set_socket_option(int sockfd, int level, int optname, const void *opt
 #endif
 }
 
+// recv gives up after ms, 0 blocks again
+inline int set_receive_timeout(int sockfd, int ms) {
+#if __unix__
+    timeval tv;
+    tv.tv_sec = ms / 1000;
+    tv.tv_usec = (ms % 1000) * 1000;
+    return setsockopt(sockfd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+#elif _WIN32
+    DWORD timeout = (DWORD)ms;
+    return setsockopt((SOCKET)sockfd, SOL_SOCKET, SO_RCVTIMEO, (const char*)&timeout, sizeof(timeout));
+#else
+    return -1;
+#endif
+}
+
 // convert ip address
 inline unsigned long inet_address(const char *cp) {
 #if __unix__
@@ -273,6 +289,7 @@ constexpr int ADDRESS_FAMILY_INET6 = AF_INET6;
 constexpr int SOCKET_LEVEL = SOL_SOCKET;
 constexpr int SOCKET_REUSEADDR = SO_REUSEADDR;
 constexpr int SOCKET_REUSEPORT = SO_REUSEPORT; 
+constexpr int SOCKET_MAX_BACKLOG = SOMAXCONN;
 constexpr int SHUTDOWN_READ = SHUT_RD;
 constexpr int SHUTDOWN_WRITE = SHUT_WR;
 constexpr int SHUTDOWN_BOTH = SHUT_RDWR;
@@ -286,6 +303,7 @@ constexpr int ADDRESS_FAMILY_INET6 = AF_INET6;
 constexpr int SOCKET_LEVEL = SOL_SOCKET;
 constexpr int SOCKET_REUSEADDR = SO_REUSEADDR;
 constexpr int SOCKET_REUSEPORT = 0; // winsock doesn't have SO_REUSEPORT on individual sockets
+constexpr int SOCKET_MAX_BACKLOG = SOMAXCONN;
 constexpr int SHUTDOWN_READ = SD_RECEIVE;
 constexpr int SHUTDOWN_WRITE = SD_SEND;
 constexpr int SHUTDOWN_BOTH = SD_BOTH;
@@ -300,6 +318,7 @@ constexpr int ADDRESS_FAMILY_INET6 = 10;
 constexpr int SOCKET_LEVEL = 1;
 constexpr int SOCKET_REUSEADDR = 2;
 constexpr int SOCKET_REUSEPORT = 15;
+constexpr int SOCKET_MAX_BACKLOG = 128;
 constexpr int SHUTDOWN_READ = 0;
 constexpr int SHUTDOWN_WRITE = 1;
 constexpr int SHUTDOWN_BOTH = 2;
@@ -1,8 +1,10 @@
 #pragma once
 
 #include <raylib.h>
+#include <cstdint>
 #include <vector>
 #include "constants.hpp"
+#include "map_rng.hpp"
 
 enum class ObjectType {
     Generic = 0,
@@ -111,66 +113,73 @@ netvent::Table objects_to_table(std::vector<Object> objects) {
 
 std::vector<Object> objects;
 
-inline std::vector<Object> get_rand_cubes(int divide_how_many_can_fit_by, int cube_size) {
+// bump whenever get_rand_cubes would place cubes differently for the same
+// seed, clients with another version ask for the cube list instead
+const int MAP_GEN_VERSION = 2;
+const int MAP_CUBE_SIZE = 50;
+
+// the cubes inside area (one chunk of the world) for a seed. server and
+// clients both run this, the server only sends the seed. cubes sit on a 50px
+// grid, stay 200px off the world edge and off the map objects in keep_clear
+inline std::vector<Object> get_rand_cubes(uint64_t seed, Rectangle area, int cube_size,
+                                          const std::vector<Object>& keep_clear) {
     std::vector<Object> cubes;
+    MapRng rng(seed);
     
     const int TILE_SIZE = 50;
     const int MARGIN = 200; // 200px margin
     
-    int effective_width = PLAYING_AREA.width - (2 * MARGIN);
-    int effective_height = PLAYING_AREA.height - (2 * MARGIN);
-    
-    int tiles_x = effective_width / TILE_SIZE;
-    int tiles_y = effective_height / TILE_SIZE;
-    int total_tiles = tiles_x * tiles_y;
-    
-    int min_cubes = total_tiles / 10;  
-    int max_cubes = total_tiles / 3;  
-    int num_cubes_to_spawn = GetRandomValue(min_cubes, max_cubes);
-    
-    // barrel position
-    const int BARREL_SIZE = 50;
-    const int BARREL_COLLISION_SIZE = BARREL_SIZE * 2;
-    Rectangle barrel_area = {
-        (PLAYING_AREA.width / 2) - (BARREL_COLLISION_SIZE / 2),
-        (PLAYING_AREA.height / 2) - (BARREL_COLLISION_SIZE / 2),
-        BARREL_COLLISION_SIZE,
-        BARREL_COLLISION_SIZE
-    };
+    int tiles_x = (int)area.width / TILE_SIZE;
+    int tiles_y = (int)area.height / TILE_SIZE;
     
     std::vector<std::pair<int, int>> available_tiles;
     for (int x = 0; x < tiles_x; x++) {
         for (int y = 0; y < tiles_y; y++) {
-            float world_x = MARGIN + (x * TILE_SIZE);
-            float world_y = MARGIN + (y * TILE_SIZE);
+            float world_x = area.x + (x * TILE_SIZE);
+            float world_y = area.y + (y * TILE_SIZE);
+            if (world_x < MARGIN || world_x + TILE_SIZE > PLAYING_AREA.width - MARGIN ||
+                world_y < MARGIN || world_y + TILE_SIZE > PLAYING_AREA.height - MARGIN) {
+                continue;
+            }
             
-            // collision check with barrel
+            // collision check with the barrel and chargers
             Rectangle tile_rect = {world_x, world_y, (float)cube_size, (float)cube_size};
-            
-            if (!CheckCollisionRecs(tile_rect, barrel_area)) {
+            bool clear = true;
+            for (const Object& object : keep_clear) {
+                if (CheckCollisionRecs(tile_rect, object.bounds)) {
+                    clear = false;
+                    break;
+                }
+            }
+            if (clear) {
                 available_tiles.push_back({x, y});
             }
         }
     }
     
+    int total_tiles = (int)available_tiles.size();
+    int min_cubes = total_tiles / 10;  
+    int max_cubes = total_tiles / 3;  
+    int num_cubes_to_spawn = rng.range(min_cubes, max_cubes);
+    
     // shuffle the available tiles to get random placement
-    for (int i = available_tiles.size() - 1; i > 0; i--) {
-        int j = GetRandomValue(0, i);
+    for (int i = (int)available_tiles.size() - 1; i > 0; i--) {
+        int j = rng.range(0, i);
         std::swap(available_tiles[i], available_tiles[j]);
     }
     
-    for (int i = 0; i < num_cubes_to_spawn && i < available_tiles.size(); i++) {
+    for (int i = 0; i < num_cubes_to_spawn && i < (int)available_tiles.size(); i++) {
         int tile_x = available_tiles[i].first;
         int tile_y = available_tiles[i].second;
         
-        float world_x = MARGIN + (tile_x * TILE_SIZE);
-        float world_y = MARGIN + (tile_y * TILE_SIZE);
+        float world_x = area.x + (tile_x * TILE_SIZE);
+        float world_y = area.y + (tile_y * TILE_SIZE);
         
         // get random color (not gonna be used anyway tho, probably should be removed)
         Color color = {
-            (unsigned char)GetRandomValue(0, 255),
-            (unsigned char)GetRandomValue(0, 255),
-            (unsigned char)GetRandomValue(0, 255),
+            (unsigned char)rng.range(0, 255),
+            (unsigned char)rng.range(0, 255),
+            (unsigned char)rng.range(0, 255),
             255
         };
         
@@ -183,74 +192,104 @@ inline std::vector<Object> get_rand_cubes(int divide_how_many_can_fit_by, int cu
     return cubes;
 }
 
-void init_map_objects(Texture2D barrel_texture, Texture2D charger_texture) {
-    objects.clear();
+// FNV-1a over the cube rectangles and types, so a client can tell its
+// rebuilt map is the server's
+inline uint32_t cubes_checksum(const std::vector<Object>& cubes) {
+    uint32_t hash = 2166136261u;
+    auto mix = [&hash](int32_t v) {
+        for (int b = 0; b < 4; b++) {
+            hash ^= (uint32_t)(v >> (b * 8)) & 0xff;
+            hash *= 16777619u;
+        }
+    };
+    for (const Object& cube : cubes) {
+        mix((int32_t)cube.bounds.x);
+        mix((int32_t)cube.bounds.y);
+        mix((int32_t)cube.bounds.width);
+        mix((int32_t)cube.bounds.height);
+        mix((int32_t)cube.type);
+    }
+    return hash;
+}
+
+// the barrel in the middle and a charger halfway along each edge, wherever
+// the world ends. same on server and clients, in this order
+inline std::vector<Object> map_landmarks() {
+    std::vector<Object> landmarks;
     
-    // add barrel in center
+    // barrel in center
     const int BARREL_SIZE = 50;
     const int BARREL_COLLISION_SIZE = BARREL_SIZE * 2;
-    objects.push_back(Object(
+    landmarks.push_back(Object(
         {
             (PLAYING_AREA.width / 2) - (BARREL_COLLISION_SIZE / 2),
             (PLAYING_AREA.height / 2) - (BARREL_COLLISION_SIZE / 2),
             BARREL_COLLISION_SIZE,
             BARREL_COLLISION_SIZE
         },
-        barrel_texture,
+        WHITE,
         ObjectType::Barrel
     ));
 
-    // add charging stations
+    // charging stations
     const int CHARGE_SIZE = 64;
     const int CHARGE_OFFSET = 32;
     
     // left charger
-    objects.push_back(Object(
+    landmarks.push_back(Object(
         {
             CHARGE_OFFSET,
             (PLAYING_AREA.height / 2) - CHARGE_OFFSET,
             CHARGE_SIZE,
             CHARGE_SIZE
         },
-        charger_texture,
+        WHITE,
         ObjectType::Charger
     ));
 
     // right charger
-    objects.push_back(Object(
+    landmarks.push_back(Object(
         {
             PLAYING_AREA.width - CHARGE_OFFSET - CHARGE_SIZE,
             (PLAYING_AREA.height / 2) - CHARGE_OFFSET,
             CHARGE_SIZE,
             CHARGE_SIZE
         },
-        charger_texture,
+        WHITE,
         ObjectType::Charger
     ));
 
     // top charger
-    objects.push_back(Object(
+    landmarks.push_back(Object(
         {
             (PLAYING_AREA.width / 2) - CHARGE_OFFSET,
             CHARGE_OFFSET,
             CHARGE_SIZE,
             CHARGE_SIZE
         },
-        charger_texture,
+        WHITE,
         ObjectType::Charger
     ));
 
     // bottom charger
-    objects.push_back(Object(
+    landmarks.push_back(Object(
         {
             (PLAYING_AREA.width / 2) - CHARGE_OFFSET,
             PLAYING_AREA.height - CHARGE_OFFSET - CHARGE_SIZE,
             CHARGE_SIZE,
             CHARGE_SIZE
         },
-        charger_texture,
+        WHITE,
         ObjectType::Charger
     ));
 
-    
-}
\ No newline at end of file
+    return landmarks;
+}
+
+// textures are only set on the client, the server leaves them empty
+void init_map_objects(Texture2D barrel_texture, Texture2D charger_texture) {
+    objects = map_landmarks();
+    for (Object& object : objects) {
+        object.texture = object.type == ObjectType::Barrel ? barrel_texture : charger_texture;
+    }
+}
@@ -13,74 +13,128 @@ enum Weapon {
   umbrella = 2
 };
 
+// replicated fields. the server sets these in Player::dirty whenever it
+// changes one, so snapshots only re-read players that actually changed
+enum PlayerField {
+  FIELD_POS = 1 << 0,
+  FIELD_ROT = 1 << 1,
+  FIELD_WEAPON = 1 << 2,
+  FIELD_COLOR = 1 << 3,
+  FIELD_USERNAME = 1 << 4,
+  FIELD_ALL = (1 << 5) - 1
+};
+
+// movement keys of an input command
+enum InputKey {
+  INPUT_UP = 1 << 0,
+  INPUT_DOWN = 1 << 1,
+  INPUT_LEFT = 1 << 2,
+  INPUT_RIGHT = 1 << 3
+};
+
+// one frame of input, sequenced so the server can ack it
+struct InputCommand {
+  int seq = 0;
+  int keys = 0;
+  float rot = 0;
+};
+
+inline int read_move_keys() {
+  int keys = 0;
+  if (IsKeyDown(KEY_W))
+    keys |= INPUT_UP;
+  if (IsKeyDown(KEY_S))
+    keys |= INPUT_DOWN;
+  if (IsKeyDown(KEY_A))
+    keys |= INPUT_LEFT;
+  if (IsKeyDown(KEY_D))
+    keys |= INPUT_RIGHT;
+  return keys;
+}
+
+// what a player looks like. changes rarely and is only read by joins,
+// snapshots of players that changed it and the name/color drawing, so it
+// lives apart from Player (see PlayerStore)
+struct PlayerLooks {
+  Color color = RED;
+  std::string username = std::string("unset");
+
+  PlayerLooks() {}
+
+  PlayerLooks(netvent::Table tbl) {
+    username = tbl[netvent::val("username")].as_string();
+    color = color_from_table(tbl[netvent::val("color")].as_table());
+  }
+};
+
+// what the tick, replication and draw loops read every frame, kept small
+// so walking all players stays in cache
 struct Player {
 public:
   int x = 0;
   int y = 0;
-  int nx = 0;
-  int ny = 0;
   int speed = 2;
-  Color color = RED;
-  std::string username = std::string("unset");
   float rot = 0;
   int weapon_id = 0;  // 0 = gun or knife (default), 1 = flashlight, 2 = umbrella
+  int dirty = FIELD_ALL; // PlayerField bits changed since the last snapshot
 
-  Player(int x, int y) : x(x), y(y), nx(x), ny(y) {}
+  Player(int x, int y) : x(x), y(y) {}
 
-  Player() : x(100), y(100), nx(100), ny(100) {};
+  Player() : x(100), y(100) {};
 
   Player(netvent::Table tbl) {
     std::cout << "Player(netvent::Table tbl)" << std::endl;
     x = tbl[netvent::val("x")].as_int();
     y = tbl[netvent::val("y")].as_int();
-    nx = x;
-    ny = y;
-    username = tbl[netvent::val("username")].as_string();
     weapon_id = tbl[netvent::val("weapon_id")].as_int();
     rot = tbl[netvent::val("rot")].as_float();
-    color = color_from_table(tbl[netvent::val("color")].as_table());
   }
 
-  netvent::Table to_table(int id) {
+  netvent::Table to_table(int id, const PlayerLooks &looks) const {
     return netvent::map_table({
       {"id", netvent::val(id)},
       {"x", netvent::val(this->x)},
       {"y", netvent::val(this->y)},
-      {"username", netvent::val(this->username)},
+      {"username", netvent::val(looks.username)},
       {"weapon_id", netvent::val(this->weapon_id)},
       {"rot", netvent::val(this->rot)},
-      {"color", netvent::val(color_to_table(this->color))}
+      {"color", netvent::val(color_to_table(looks.color))}
     });
   }
 
-  bool move(CanMoveState can_move_state) {
-    bool out = IsKeyDown(KEY_W) || IsKeyDown(KEY_A) || IsKeyDown(KEY_S) ||
-               IsKeyDown(KEY_D);
+  // one movement step for the given keys
+  bool apply_input(int keys, CanMoveState can_move_state) {
     int dir_x = 0;
     int dir_y = 0;
 
-    if (IsKeyDown(KEY_W) && can_move_state.up)
+    if ((keys & INPUT_UP) && can_move_state.up)
       dir_y -= speed;
-    if (IsKeyDown(KEY_S) && can_move_state.down)
+    if ((keys & INPUT_DOWN) && can_move_state.down)
       dir_y += speed;
-    if (IsKeyDown(KEY_A) && can_move_state.left)
+    if ((keys & INPUT_LEFT) && can_move_state.left)
       dir_x -= speed;
-    if (IsKeyDown(KEY_D) && can_move_state.right)
+    if ((keys & INPUT_RIGHT) && can_move_state.right)
       dir_x += speed;
 
-    int new_x = this->x + dir_x;
-    int new_y = this->y + dir_y;
-    
-    /* // handled in collision.hpp
-    if (new_x >= PLAYING_AREA.x && new_x <= PLAYING_AREA.width - 100) {
-      this->x = new_x;
-    }
-    if (new_y >= PLAYING_AREA.y && new_y <= PLAYING_AREA.height - 100) {
-      this->y = new_y;
-    } */
-
-    return out;
+    // bounds are handled in collision.hpp
+    this->x += dir_x;
+    this->y += dir_y;
+
+    return keys != 0;
+  }
+
+  bool move(CanMoveState can_move_state) {
+    return apply_input(read_move_keys(), can_move_state);
   }
 };
 
+// one movement tick against the map. client prediction and the server's
+// authoritative movement both run exactly this
+inline bool simulate_move(Player &p, int keys, const AabbBatch &cube_colliders) {
+  CanMoveState can_move_state = update_can_move_state(
+      Rectangle{(float)p.x, (float)p.y, 50, 50}, cube_colliders, 50, 0.1f,
+      Rectangle{0, 0, (float)PLAYING_AREA.width, (float)PLAYING_AREA.height});
+  return p.apply_input(keys, can_move_state);
+}
+
 #endif
@@ -0,0 +1,151 @@
+#pragma once
+#include "interpolation.hpp"
+#include "player.hpp"
+#include <cstddef>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+// players packed contiguously plus an id -> index table, so walking everyone
+// is a linear scan and lookups by id are O(1). ids are the small ints the
+// server hands out (lowest free one), so the table stays short.
+//
+// same interface as the std::map it replaced (entries are (id, player)
+// pairs), but erase swap-removes, so the order changes when a player leaves.
+//
+// the entries only hold the small Player records the tick, replication and
+// draw loops walk every frame. what is read rarely (PlayerLooks, and the
+// client's interpolation buffers) lives in parallel arrays at the same index
+class PlayerStore {
+public:
+  // ids are connection slots, far below this. anything outside [0, this)
+  // is refused instead of growing the index table to fit it
+  static const int MAX_ID = 1 << 16;
+
+  typedef std::pair<int, Player> Entry;
+  typedef std::vector<Entry>::iterator iterator;
+  typedef std::vector<Entry>::const_iterator const_iterator;
+
+  // like std::map, inserts a default Player if id isn't there. throws
+  // std::out_of_range for an id outside [0, MAX_ID)
+  Player &operator[](int id) {
+    int index = index_of(id);
+    if (index == -1)
+      index = place(id, Player());
+    return entries[index].second;
+  }
+
+  Player &at(int id) {
+    int index = index_of(id);
+    if (index == -1)
+      throw std::out_of_range("PlayerStore::at");
+    return entries[index].second;
+  }
+
+  const Player &at(int id) const {
+    int index = index_of(id);
+    if (index == -1)
+      throw std::out_of_range("PlayerStore::at");
+    return entries[index].second;
+  }
+
+  // false if id is already taken (the existing player is kept), throws
+  // like operator[] for a bad id
+  bool insert(const Entry &entry, const PlayerLooks &looks = PlayerLooks()) {
+    if (index_of(entry.first) != -1)
+      return false;
+    looks_list[place(entry.first, entry.second)] = looks;
+    return true;
+  }
+
+  iterator find(int id) {
+    int index = index_of(id);
+    return index == -1 ? entries.end() : entries.begin() + index;
+  }
+
+  const_iterator find(int id) const {
+    int index = index_of(id);
+    return index == -1 ? entries.end() : entries.begin() + index;
+  }
+
+  size_t count(int id) const { return index_of(id) == -1 ? 0 : 1; }
+
+  size_t erase(int id) {
+    int index = index_of(id);
+    if (index == -1)
+      return 0;
+    int last = (int)entries.size() - 1;
+    if (index != last) {
+      entries[index] = std::move(entries[last]);
+      looks_list[index] = std::move(looks_list[last]);
+      motions[index] = motions[last];
+      dense_index[entries[index].first] = index;
+    }
+    entries.pop_back();
+    looks_list.pop_back();
+    motions.pop_back();
+    dense_index[id] = -1;
+    return 1;
+  }
+
+  void clear() {
+    entries.clear();
+    looks_list.clear();
+    motions.clear();
+    dense_index.clear();
+  }
+
+  size_t size() const { return entries.size(); }
+  bool empty() const { return entries.empty(); }
+
+  iterator begin() { return entries.begin(); }
+  iterator end() { return entries.end(); }
+  const_iterator begin() const { return entries.begin(); }
+  const_iterator end() const { return entries.end(); }
+
+  // name and color of a player, throws like at() if id isn't there
+  PlayerLooks &looks(int id) {
+    int index = index_of(id);
+    if (index == -1)
+      throw std::out_of_range("PlayerStore::looks");
+    return looks_list[index];
+  }
+  const PlayerLooks &looks(int id) const {
+    int index = index_of(id);
+    if (index == -1)
+      throw std::out_of_range("PlayerStore::looks");
+    return looks_list[index];
+  }
+  // same, by position in the iteration order
+  const PlayerLooks &looks_at(size_t index) const { return looks_list[index]; }
+
+  // client: timestamped server positions of a remote player. the id must exist
+  InterpolationBuffer &motion(int id) { return motions[index_of(id)]; }
+  // same, by position in the iteration order
+  InterpolationBuffer &motion_at(size_t index) { return motions[index]; }
+
+private:
+  std::vector<Entry> entries;
+  std::vector<PlayerLooks> looks_list;
+  std::vector<InterpolationBuffer> motions;
+  std::vector<int> dense_index; // id -> index into entries, -1 if absent
+
+  int index_of(int id) const {
+    if (id < 0 || id >= (int)dense_index.size())
+      return -1;
+    return dense_index[id];
+  }
+
+  int place(int id, const Player &player) {
+    if (id < 0 || id >= MAX_ID)
+      throw std::out_of_range("PlayerStore: bad id");
+    if (id >= (int)dense_index.size())
+      dense_index.resize(id + 1, -1);
+    int index = (int)entries.size();
+    entries.push_back({id, player});
+    looks_list.push_back(PlayerLooks());
+    motions.push_back(InterpolationBuffer());
+    dense_index[id] = index;
+    return index;
+  }
+};
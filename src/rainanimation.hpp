@@ -2,6 +2,7 @@
 #include <iostream>
 #include <vector>
 #include <raylib.h>
+#include "aabb.hpp"
 #include "constants.hpp"
 #include <random>
 
@@ -20,6 +21,7 @@ private:
     float nextDropDelay = 0.0f;
     bool active = false;
     std::vector<RainDrop> raindrops;
+    AabbBatch player_rects;
     const int MAX_DROPS = 100;
     const float MIN_SPEED = 300.0f;
     const float MAX_SPEED = 600.0f;
@@ -78,17 +80,21 @@ public:
         }
     }
 
-    void draw(playermap players) {
+    void draw(const playermap &players) {
         if (!active) return;
 
-        for (auto& drop : raindrops) {
-            for (const auto& [id, player] : players) {
-                if (raindrop_touching_player(drop, player)) {
-                    drop.hidden = true;
-                } else {
-                    drop.hidden = false;
-                }
+        // players (and their umbrellas) shelter the drops above them
+        player_rects.clear();
+        for (const auto& [id, player] : players) {
+            if (player.weapon_id == (int)Weapon::umbrella) {
+                player_rects.push_back({(float)player.x, (float)player.y - 85, 75, 150});
+            } else {
+                player_rects.push_back({(float)player.x, (float)player.y, 50, 50});
             }
+        }
+
+        for (auto& drop : raindrops) {
+            drop.hidden = raindrop_touching_player(drop, player_rects);
             if (!drop.hidden) {
                 Color dropColor = {0, 255, 0, (unsigned char)(drop.alpha * 255)}; 
                 DrawCircle(drop.position.x, drop.position.y, drop.size, dropColor);
@@ -119,19 +125,8 @@ private:
         }
     }
 
-    bool raindrop_touching_player(RainDrop drop, Player player) {
+    bool raindrop_touching_player(const RainDrop &drop, const AabbBatch &player_rects) {
         Rectangle drop_rect = {drop.position.x - drop.size, drop.position.y - drop.size, drop.size * 2, drop.size * 2};
-        Rectangle player_rect;
-
-        if (player.weapon_id == (int)Weapon::umbrella) {
-            player_rect = {(float)player.x, (float)player.y - 85, 75, 150};
-        } else {
-            player_rect = {(float)player.x, (float)player.y, 50, 50};
-        }
-
-        if (CheckCollisionRecs(drop_rect, player_rect)) {
-            return true;
-        }
-        return false;
+        return aabb_any_hit(drop_rect, player_rects);
     }
 };
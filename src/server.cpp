@@ -1,16 +1,33 @@
+#include "aabb.hpp"
+#include "checkpoint.hpp"
 #include "constants.hpp"
 #include "game.hpp"
+#include "handoff.hpp"
+#include "history.hpp"
+#include "interest.hpp"
+#include "jobs.hpp"
 #include "math.h"
 #include "netvent.hpp"
 #include "codes.hpp"
 #include "networking.hpp"
 #include "objects.hpp"
 #include "player.hpp"
+#include "sim_clock.hpp"
+#include "slab.hpp"
+#include "snapshot.hpp"
+#include "supervisor.hpp"
+#include "timer_wheel.hpp"
 #include "utils.hpp"
+#include "world.hpp"
+#include <algorithm>
 #include <array>
 #include <atomic>
 #include <chrono>
+#include <climits>
+#include <condition_variable>
 #include <csignal>
+#include <cstring>
+#include <deque>
 #include <cstdio>
 #include <cstdlib>
 #include <iostream>
@@ -28,98 +45,626 @@
 #include <unordered_map>
 #include <utility>
 
+#if __unix__
+#include <sys/random.h>
+#endif
+
 static int server_socket_fd = -1;
 std::atomic<bool> server_running{true};
 
-std::mutex game_mutex;
-Game game;
-
-// bullet id 
-static std::atomic<int> next_bullet_id{0};
-std::mutex bullet_id_mutex;
-
-int get_next_bullet_id() {
-    std::lock_guard<std::mutex> lock(bullet_id_mutex);
-    int id = next_bullet_id++;
-    if (next_bullet_id >= 10000) next_bullet_id = 0;
-    return id;
-}
-
-std::mutex assassin_mutex;
-int assassin_id = -1;
-int assassin_target_id = -1; // target id
-Color original_assassin_color;
-std::chrono::steady_clock::time_point assassin_start_time;
-std::set<int> used_assassin_ids; // used id(s)
-
-// darkness event tracking
-std::mutex darkness_mutex;
-bool darkness_active = false;
-std::chrono::steady_clock::time_point darkness_start_time;
+// shared time base, clients sync to it on join
+SimClock sim_clock;
 
-// acid rain event tracking
-std::mutex acid_rain_mutex;
-bool acid_rain_active = false;
-std::chrono::steady_clock::time_point acid_rain_start_time;
+// --authoritative: clients send input commands and the server moves them
+static bool authoritative_movement = false;
 
 typedef std::list<std::pair<int, std::string>> packetlist;
 
+// everything clients sent, in order, by connection handle. the main loop
+// hands each packet to the room of its sender
 std::mutex packets_mutex;
 packetlist packets;
 
-std::mutex clients_mutex;
-std::unordered_map<int, client> clients;
+enum EventType {
+  Darkness = 0,
+  Assasin = 1,
+  Clear = 2,
+  AcidRain = 3,
+  NOTHING = 100
+};
+
+// how far back a shooter's view can be rewound
+const int MAX_REWIND_MS = 400;
+
+struct BulletHit {
+  int bullet_id, player_id;
+};
+
+// when a snapshot seq was published, acks turn this into an rtt
+struct PublishedSeq {
+  int seq = -1;
+  int64_t time_ms = 0;
+};
 
-std::mutex running_mutex;
-std::map<int, bool> is_running;
+// per client replication state, owned by the replication thread
+struct ClientReplication {
+  int session = -1;
+  int acked = -1;     // newest snapshot the client confirmed, the delta baseline
+  int last_sent = -1;
+  int input_ack_sent = -1; // newest input seq reported back to the client
+  SnapshotRing sent;  // what the client knows as of each snapshot we sent
+};
 
-int last_assassin_id = -1; // previous assassin id
+struct SnapshotAck {
+  int client_id, session, seq;
+};
 
-std::mutex pending_assassin_mutex;
-std::map<int, std::chrono::steady_clock::time_point> pending_assassins;
+// authoritative movement: each client's inputs go through a jitter buffer.
+// commands wait until a few are queued (or the oldest has waited long
+// enough), then exactly one is applied per sim tick. a client sending faster
+// than that loses its oldest commands past INPUT_BUFFER_MAX instead of
+// moving faster
+const int INPUT_BUFFER_TARGET = 3;
+const int INPUT_BUFFER_MAX = 12;
+const int INPUT_MAX_WAIT_MS = 50;
+
+struct BufferedInput {
+  InputCommand cmd;
+  int64_t arrived_ms;
+};
+struct InputBuffer {
+  std::deque<BufferedInput> commands;
+  bool draining = false;
+  int last_seq = -1; // newest command applied
+};
 
-std::set<int> previous_targets; // previous targets
+struct JoinEntry {
+  PlayerState state;
+  std::string text; // "id={...}" inside the players table
+};
 
-// cubes on the map
-std::vector<Object> cubes = get_rand_cubes(155, 50);
-//std::vector<Object> cubes;
+// one match: its players, events, map and clients. rooms share nothing but
+// the clock, the world size and the worker threads, and every room ticks as
+// one job on those, so a process packs many small matches.
+//
 // Lock order: game_mutex -> assassin_mutex -> pending_assassin_mutex ->
-// darkness_mutex -> acid_rain_mutex -> clients_mutex This order must be
-// maintained in all functions to prevent deadlocks
+// darkness_mutex -> acid_rain_mutex -> clients_mutex -> replication_mutex
+// This order must be maintained in all functions to prevent deadlocks.
+// no room locks are held while taking the locks of another room
+struct Room : std::enable_shared_from_this<Room> {
+  int id = 0;
+  int members = 0; // connections in the room (guarded by rooms_mutex)
+
+  std::mutex game_mutex;
+  Game game;
+
+  // event expiry, assassin timeouts and the random event schedule. advanced
+  // by the room's tick, so every callback runs with the rest of the room
+  TimerWheel timers;
+
+  std::mutex assassin_mutex;
+  int assassin_id = -1;
+  int assassin_target_id = -1; // target id
+  Color original_assassin_color;
+  int assassin_timer = -1; // ends the event after 60 seconds
+  std::set<int> used_assassin_ids; // used id(s)
+  int last_assassin_id = -1; // previous assassin id
+  std::set<int> previous_targets; // previous targets
+
+  std::mutex pending_assassin_mutex;
+  std::map<int, int> pending_assassins; // assassin id -> retarget timer
+
+  // darkness event tracking
+  std::mutex darkness_mutex;
+  bool darkness_active = false;
+  int darkness_timer = -1;
+
+  // acid rain event tracking
+  std::mutex acid_rain_mutex;
+  bool acid_rain_active = false;
+  int acid_rain_timer = -1;
+
+  // this tick's packets, filled by the main loop while no room ticks
+  packetlist packets;
+
+  // the room's connections (the threads stay in connections)
+  std::mutex clients_mutex;
+  std::unordered_map<int, client> clients;
+
+  // the map, generated from map_seed in chunks. clients stream the chunks
+  // around them and rebuild their cubes from the seed, so neither joins nor
+  // the client grow with the world (--world-tiles)
+  uint32_t map_seed = 0;
+  ChunkMap map_chunks;
+  // MSG_CHUNK for every chunk, row by row
+  std::vector<std::string> chunk_messages;
+  // MSG_MAP_CUBES, same layout, made on the first MSG_MAP_REQUEST for that
+  // chunk since clients normally rebuild the cubes themselves. tick only
+  std::vector<std::string> cube_messages;
+
+  // the map's part of the join handshake, serialized once, and the players
+  // as serialized entries that are only redone when that player changed
+  // since the last join. join_mutex is a leaf lock
+  std::string join_static_fields;
+  std::mutex join_mutex;
+  std::unordered_map<int, JoinEntry> join_entries;
+
+  // player hitboxes per tick, bullets check the past the shooter was
+  // looking at (guarded by game_mutex)
+  PositionHistory player_history;
+
+  // bullet spawns and player hits collected during a tick, sent as one
+  // MSG_BULLET_BATCH when the tick ends (guarded by game_mutex). clients
+  // simulate bullets from the spawn data and despawn them on static geometry
+  // themselves, so the only despawns sent are hits
+  std::vector<Bullet> tick_bullet_spawns;
+  std::vector<BulletHit> tick_bullet_hits;
+  std::vector<int> bullet_outcomes;
+
+  // replicated state of every player, refreshed from Player::dirty at the
+  // end of every tick (guarded by game_mutex)
+  std::unordered_map<int, PlayerState> world_state;
+  // tick only: the snapshot timer sets snapshot_due, the next publish then
+  // gets the next seq and goes out to clients
+  int snapshot_seq = 0;
+  bool snapshot_due = false;
+  PublishedSeq published_ms[SNAPSHOT_RING];
+
+  // latest published tick. everything outside the simulation (joins, the
+  // console, replication) reads this instead of locking the game state
+  std::shared_ptr<const WorldSnapshot> published_world;
+
+  // connection bookkeeping (guarded by clients_mutex): a session number per
+  // join, so a reused id isn't mistaken for the client that had it before,
+  // and the smoothed rtt from snapshot acks
+  std::unordered_map<int, int> client_sessions;
+  std::unordered_map<int, int> client_rtt_ms;
+
+  // owned by the replication thread
+  std::unordered_map<int, ClientReplication> replication;
+  // hand-off between the tick and the replication thread (guarded by
+  // replication_mutex)
+  std::shared_ptr<const WorldSnapshot> replication_next;
+  std::vector<SnapshotAck> pending_acks;
+
+  // messages built on the tick and replication threads, queued per client
+  // and written once at the end of the tick (guarded by clients_mutex)
+  std::unordered_map<int, std::string> outboxes;
+
+  // authoritative movement (guarded by game_mutex)
+  std::unordered_map<int, InputBuffer> input_buffers;
+  int last_move_tick = -1;
+
+  std::atomic<int> last_tick_us{0};
+};
 
-enum EventType {
-  Darkness = 0,
-  Assasin = 1,
-  Clear = 2,
-  AcidRain = 3,
-  NOTHING = 100
+// the rooms by id. room 0 always exists, the others go away once empty
+// (guarded by rooms_mutex, which comes before any other lock)
+static std::mutex rooms_mutex;
+static std::map<int, std::shared_ptr<Room>> rooms;
+static int next_room_id = 0;
+// new connections go to the first room with fewer players than this
+// (--room-size), a full lobby gets a new room
+static int room_size = 16;
+// rooms clients may open with MSG_ROOM_JOIN
+const int MAX_ROOMS = 64;
+
+// join sessions, unique across rooms
+static std::atomic<int> next_session{0};
+
+// one client connection, everything about it in one record. the slot index
+// is the player id
+struct Connection {
+  int socket = -1;
+  std::thread thread;
+  std::atomic<bool> running{false};   // cleared to stop the recv thread
+  std::atomic<bool> receiving{false}; // the recv thread is still in there
+  std::shared_ptr<Room> room; // guarded by rooms_mutex
+  std::string recv_buffer;    // partial messages, the recv thread's
+
+  // resuming (guarded by rooms_mutex): the token the client got on join.
+  // while the client is gone (parked), when its player goes for good and
+  // which players the client knew of
+  std::string resume_token;
+  int64_t parked_until_ms = -1;
+  std::vector<int> known_players;
 };
 
-static std::vector<Rectangle> bullet_colliders;
+// every connection, whatever room it is in. acquire / release and the
+// socket and thread of a record are guarded by connections_mutex (after
+// rooms_mutex). records never move, so a recv thread holds on to its own
+const int MAX_CONNECTIONS = 1024;
+static std::mutex connections_mutex;
+static Slab<Connection> connections(MAX_CONNECTIONS);
+
+// every connection's resume token (guarded by rooms_mutex). a connection
+// that comes in with one in MSG_RESUME takes over the parked connection it
+// names, the player id with it
+static std::unordered_map<std::string, int> resume_tokens;
+// random bytes per token, from the system's CSPRNG: a token is all it takes
+// to take over (or cut off) a player's session
+const int RESUME_TOKEN_BYTES = 16;
+// how long a new connection gets to send MSG_RESUME (clients send it right
+// away), and the old connection to be parked if it hasn't noticed the drop
+const int RESUME_WAIT_MS = 250;
+
+// connections whose recv thread ended, for the main loop to clean up
+// (closed_mutex is a leaf lock)
+static std::mutex closed_mutex;
+static std::vector<int> closed_connections;
+
+// cleared to stop the accept thread (a handoff), accepting says it's out
+static std::atomic<bool> accept_new{true};
+static std::atomic<bool> accepting{false};
+
+// rooms with a snapshot waiting for the replication thread, oldest first
+// (guarded by replication_mutex)
+static std::mutex replication_mutex;
+static std::condition_variable replication_wake;
+static std::deque<std::shared_ptr<Room>> replication_ready;
+
+// stage timings for the console
+static std::atomic<int> last_tick_us{0};
+static std::atomic<int> last_replicate_us{0};
+// -1 until the first checkpoint (--checkpoint)
+static std::atomic<int> last_capture_us{-1};
+static std::atomic<int> last_checkpoint_us{-1};
+
+// worker threads for the rooms' ticks and the parallel parts of a tick and
+// of replication (--threads, default one per core)
+static JobSystem jobs;
+// clients per snapshot job and bullets per collision job, below that a job
+// costs more than it saves
+const size_t SNAPSHOT_JOB_GRAIN = 4;
+const size_t BULLET_JOB_GRAIN = 64;
+
+void queue_message_unlocked(Room &room, const std::string &msg, int client_id) {
+  std::string &box = room.outboxes[client_id];
+  box += msg;
+  box.push_back(';');
+}
+
+void queue_broadcast_unlocked(Room &room, const std::string &msg,
+                              int exclude = -1000) {
+  for (const auto &[id, c] : room.clients) {
+    if (id != exclude && c.first != -1) {
+      queue_message_unlocked(room, msg, id);
+    }
+  }
+}
+
+// how many ticks back a client's view of the other players is: the shot
+// travels half the rtt, the snapshot it aimed at the other half, plus about
+// one snapshot of smoothing on screen
+int rewind_ticks_unlocked(Room &room, int client_id) {
+  auto rtt = room.client_rtt_ms.find(client_id);
+  if (rtt == room.client_rtt_ms.end())
+    return 0;
+  int rewind_ms = rtt->second + SNAPSHOT_INTERVAL_MS;
+  if (rewind_ms > MAX_REWIND_MS)
+    rewind_ms = MAX_REWIND_MS;
+  return rewind_ms * SIM_TICK_RATE / 1000;
+}
+
+// one write per client per tick
+void flush_outboxes(Room &room) {
+  std::lock_guard<std::mutex> clients_lock(room.clients_mutex);
+  for (auto &[id, box] : room.outboxes) {
+    if (box.empty()) {
+      continue;
+    }
+    auto c = room.clients.find(id);
+    if (c != room.clients.end() && c->second.first != -1 &&
+        send_data(c->second.first, box.data(), box.size(), 0) < 0) {
+      print_socket_error("error sending message");
+    }
+    box.clear();
+  }
+}
 
 std::mutex objects_mutex;
+// the landmarks (objects) of every chunk and their part of MSG_CHUNK, row
+// by row. the same in every room, so the rooms' chunks share them. set with
+// objects before any room ticks, only read after that
+static std::vector<std::shared_ptr<const std::vector<Object>>> landmark_chunks;
+static std::vector<std::string> landmark_tables;
+
+void init_landmarks_unlocked() {
+  int count = world_chunks();
+  landmark_chunks.assign(count * count, nullptr);
+  landmark_tables.assign(count * count, "");
+  for (int cy = 0; cy < count; cy++) {
+    for (int cx = 0; cx < count; cx++) {
+      auto inside = std::make_shared<const std::vector<Object>>(
+          chunk_objects(objects, cx, cy));
+      landmark_tables[cy * count + cx] =
+          netvent::val(objects_to_table(*inside)).serialize();
+      landmark_chunks[cy * count + cx] = std::move(inside);
+    }
+  }
+}
+
+// ---------------------------------
+// PUBLISHING AND REPLICATION
+// every room publishes an immutable WorldSnapshot at the end of its tick.
+// every SNAPSHOT_INTERVAL_MS one of them also goes to the replication
+// thread (one for all rooms), which builds and serializes the per client
+// deltas while the next tick simulates
+// ---------------------------------
+
+Interest interest_in(const WorldSnapshot &world, int viewer_id, int subject_id) {
+  const PlayerState &viewer = world.players.at(viewer_id);
+  const PlayerState &subject = world.players.at(subject_id);
+  return player_interest(viewer.x, viewer.y,
+                         viewer.weapon_id == Weapon::flashlight,
+                         viewer_id == world.assassin_id, subject.x, subject.y,
+                         color_equal(subject.color, INVISIBLE),
+                         subject.weapon_id == Weapon::flashlight,
+                         world.darkness);
+}
+
+// the view of the world a client should have: the other players it can
+// see, with minimap-only players snapped to a cell and only moved every
+// COARSE_INTERVAL_MS
+SnapshotView build_client_view(const WorldSnapshot &world, int client_id,
+                               const SnapshotView *previous) {
+  bool coarse_refresh =
+      world.seq % (COARSE_INTERVAL_MS / SNAPSHOT_INTERVAL_MS) == 0;
+
+  SnapshotView view;
+  view.seq = world.seq;
+  for (const auto &[id, state] : world.players) {
+    if (id == client_id) {
+      continue; // clients move themselves
+    }
+    Interest level = interest_in(world, client_id, id);
+    if (level == INTEREST_NONE) {
+      continue;
+    }
+
+    PlayerState s = state;
+    if (level == INTEREST_COARSE) {
+      auto last = previous ? previous->players.find(id)
+                           : std::unordered_map<int, PlayerState>::const_iterator();
+      if (!coarse_refresh && previous && last != previous->players.end()) {
+        s.x = last->second.x;
+        s.y = last->second.y;
+      } else {
+        int cell = coarse_cell();
+        s.x = s.x / cell * cell;
+        s.y = s.y / cell * cell;
+      }
+    }
+    view.players[id] = s;
+  }
+  return view;
+}
+
+// one client's MSG_SNAPSHOT: its view as a delta against the last snapshot
+// it acknowledged, plus its input ack in authoritative mode. records what
+// was sent in its replication state
+std::string build_snapshot(const WorldSnapshot &world, int client_id,
+                           ClientReplication &rep) {
+  const SnapshotView *baseline = rep.sent.find(rep.acked);
+  SnapshotView view =
+      build_client_view(world, client_id, rep.sent.find(rep.last_sent));
+
+  std::vector<netvent::Value> entries;
+  for (const auto &[id, state] : view.players) {
+    int fields = FIELD_ALL;
+    if (baseline) {
+      auto known = baseline->players.find(id);
+      if (known != baseline->players.end()) {
+        fields = player_state_diff(known->second, state);
+      }
+    }
+    if (fields) {
+      entries.push_back(netvent::val(player_state_delta(id, state, fields)));
+    }
+  }
+
+  // goes out even with no entries: clients interpolate by time, and an
+  // empty snapshot is what tells them everyone stood still until now
+  std::map<std::string, netvent::Value> fields(
+      {{"seq", netvent::val(world.seq)},
+       {"base", netvent::val(baseline ? baseline->seq : -1)},
+       {"time_hi", netvent::val(time_hi(world.time_ms))},
+       {"time_lo", netvent::val(time_lo(world.time_ms))},
+       {"players", netvent::val(netvent::Table(entries))}});
+
+  // authoritative movement: where the server has us after our inputs
+  auto input = world.input_acks.find(client_id);
+  if (input != world.input_acks.end() && input->second != rep.input_ack_sent) {
+    const PlayerState &self = world.players.at(client_id);
+    fields["ack"] = netvent::val(input->second);
+    fields["x"] = netvent::val(self.x);
+    fields["y"] = netvent::val(self.y);
+    rep.input_ack_sent = input->second;
+  }
+
+  rep.sent.put(std::move(view));
+  rep.last_sent = world.seq;
+  return netvent::serialize_to_netvent(netvent::val(MSG_SNAPSHOT), fields);
+}
+
+// sends every client in world its snapshot. runs on the replication thread
+void replicate(Room &room, const WorldSnapshot &world) {
+  std::vector<SnapshotAck> acks;
+  {
+    std::lock_guard<std::mutex> lock(replication_mutex);
+    acks.swap(room.pending_acks);
+  }
+
+  // replication state follows the client list: new sessions start over,
+  // parked clients keep theirs for when they're back, clients that left
+  // are dropped
+  std::unordered_map<int, ClientReplication> current;
+  for (const auto &[id, session] : world.clients) {
+    auto rep = room.replication.find(id);
+    if (rep != room.replication.end() && rep->second.session == session) {
+      current[id] = std::move(rep->second);
+    } else {
+      current[id].session = session;
+    }
+  }
+  for (const auto &[id, session] : world.parked) {
+    auto rep = room.replication.find(id);
+    if (rep != room.replication.end() && rep->second.session == session)
+      current[id] = std::move(rep->second);
+  }
+  room.replication.swap(current);
+
+  for (const SnapshotAck &ack : acks) {
+    auto rep = room.replication.find(ack.client_id);
+    if (rep != room.replication.end() && rep->second.session == ack.session &&
+        ack.seq > rep->second.acked && ack.seq <= rep->second.last_sent) {
+      rep->second.acked = ack.seq;
+    }
+  }
+
+  // a job per few clients, each only touches its own replication state
+  // and message slot. queued in client order afterwards
+  std::vector<std::string> messages(world.clients.size());
+  jobs.parallel_for(world.clients.size(), SNAPSHOT_JOB_GRAIN,
+                    [&](size_t begin, size_t end) {
+    for (size_t t = begin; t < end; t++) {
+      int id = world.clients[t].first;
+      messages[t] = build_snapshot(world, id, room.replication.find(id)->second);
+    }
+  });
+
+  std::lock_guard<std::mutex> clients_lock(room.clients_mutex);
+  for (size_t t = 0; t < world.clients.size(); t++) {
+    queue_message_unlocked(room, messages[t], world.clients[t].first);
+  }
+}
+
+void replication_loop() {
+  jobs.attach(1);
+  while (true) {
+    std::shared_ptr<Room> room;
+    std::shared_ptr<const WorldSnapshot> world;
+    {
+      std::unique_lock<std::mutex> lock(replication_mutex);
+      replication_wake.wait(lock, [] {
+        return !replication_ready.empty() || !server_running;
+      });
+      if (!server_running)
+        return;
+      room = replication_ready.front();
+      replication_ready.pop_front();
+      world.swap(room->replication_next);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    replicate(*room, *world);
+    last_replicate_us = (int)std::chrono::duration_cast<std::chrono::microseconds>(
+                            std::chrono::steady_clock::now() - start)
+                            .count();
+  }
+}
+
+// the next publish goes out to clients. reschedules itself every
+// SNAPSHOT_INTERVAL_MS
+void send_snapshots(Room *room) {
+  room->timers.schedule(SNAPSHOT_INTERVAL_MS, [room]() { send_snapshots(room); });
+  room->snapshot_due = true;
+}
+
+// end of a tick: picks up what changed and publishes it
+void publish_world(Room &room) {
+  auto world = std::make_shared<WorldSnapshot>();
+  {
+    std::scoped_lock locks(room.game_mutex, room.assassin_mutex,
+                           room.darkness_mutex, room.acid_rain_mutex,
+                           room.clients_mutex);
+
+    for (auto &[id, p] : room.game.players) {
+      if (p.dirty) {
+        copy_player_fields(room.world_state[id], p,
+                           room.game.players.looks(id), p.dirty);
+        p.dirty = 0;
+      }
+    }
+    for (auto it = room.world_state.begin(); it != room.world_state.end();) {
+      if (room.game.players.count(it->first)) {
+        ++it;
+      } else {
+        it = room.world_state.erase(it);
+      }
+    }
+
+    world->tick = sim_clock.tick();
+    world->time_ms = sim_clock.now_ms();
+    world->players = room.world_state;
+    for (const auto &[id, c] : room.clients) {
+      auto session = room.client_sessions.find(id);
+      if (room.game.players.count(id) && session != room.client_sessions.end()) {
+        if (c.first != -1)
+          world->clients.push_back({id, session->second});
+        else
+          world->parked.push_back({id, session->second});
+      }
+    }
+    if (authoritative_movement) {
+      for (const auto &[id, input] : room.input_buffers) {
+        world->input_acks[id] = input.last_seq;
+      }
+    }
+    world->assassin_id = room.assassin_id;
+    world->assassin_target_id = room.assassin_target_id;
+    world->darkness = room.darkness_active;
+    world->acid_rain = room.acid_rain_active;
+
+    if (room.snapshot_due) {
+      world->seq = room.snapshot_seq++;
+      room.published_ms[world->seq % SNAPSHOT_RING] = {world->seq,
+                                                       world->time_ms};
+    }
+  }
+
+  std::shared_ptr<const WorldSnapshot> frozen = world;
+  std::atomic_store(&room.published_world, frozen);
 
-void clear_assassin_state_unlocked() {
+  if (room.snapshot_due) {
+    room.snapshot_due = false;
+    // a snapshot the replication thread hasn't started yet is replaced,
+    // clients skip a seq rather than fall further behind
+    {
+      std::lock_guard<std::mutex> lock(replication_mutex);
+      if (!room.replication_next)
+        replication_ready.push_back(room.shared_from_this());
+      room.replication_next = frozen;
+    }
+    replication_wake.notify_one();
+  }
+}
+
+void clear_assassin_state_unlocked(Room &room) {
   std::cout << "Clearing assassin state" << std::endl;
 
   // reset assassin IDs
-  assassin_id = -1;
-  assassin_target_id = -1;
+  room.assassin_id = -1;
+  room.assassin_target_id = -1;
 
   // clear pending assassins
-  pending_assassins.clear();
+  for (const auto &[id, timer] : room.pending_assassins) {
+    room.timers.cancel(timer);
+  }
+  room.pending_assassins.clear();
 
   // clear previous targets
-  previous_targets.clear();
+  room.previous_targets.clear();
 
-  // reset assassin start time
-  assassin_start_time = std::chrono::steady_clock::now();
+  // stop the timeout
+  room.timers.cancel(room.assassin_timer);
+  room.assassin_timer = -1;
 }
 
-void clear_assassin_state() {
-  std::scoped_lock all_locks(game_mutex, assassin_mutex, pending_assassin_mutex,
-                             clients_mutex);
-  clear_assassin_state_unlocked();
+void clear_assassin_state(Room &room) {
+  std::scoped_lock all_locks(room.game_mutex, room.assassin_mutex,
+                             room.pending_assassin_mutex, room.clients_mutex);
+  clear_assassin_state_unlocked(room);
 }
 
 void perform_shutdown() {
@@ -139,15 +684,15 @@ void perform_shutdown() {
 
     // stop existing clients
     {
-      std::scoped_lock lock(clients_mutex);
-      for (auto &[id, client_pair] : clients) {
-        if (client_pair.second && client_pair.second->joinable()) {
-          shutdown_socket(client_pair.first, SHUTDOWN_BOTH);
-          close_socket(client_pair.first);
-          client_pair.second->join();
+      std::scoped_lock lock(connections_mutex);
+      for (int id = 0; id < connections.capacity(); id++) {
+        Connection &c = connections[id];
+        if (connections.in_use(id) && c.thread.joinable()) {
+          shutdown_socket(c.socket, SHUTDOWN_BOTH);
+          close_socket(c.socket);
+          c.thread.join();
         }
       }
-      clients.clear();
     }
 
     std::cout << "Attempting graceful shutdown..." << std::endl;
@@ -164,127 +709,110 @@ void shutdown_server(int signum) {
   server_running = false;
 }
 
-void handle_client(int client, int id) {
-  try {
-    {
-      std::lock_guard<std::mutex> lock(game_mutex);
-      Player p(100, 100);
-      p.username = "unset";
-      p.color = RED;
-      game.players.insert({id, p});
-    }
-
-    std::ostringstream out;
-    {
-      std::scoped_lock lock(game_mutex, assassin_mutex);
-
-      for (auto &[k, v] : game.players) {
-        // sanitize
-        std::string safe_username = v.username;
-        if (safe_username.empty())
-          safe_username = "unset";
-        // remove bad characters
-        for (char &c : safe_username) {
-          if (c == ';' || c == ':' || c == ' ')
-            c = '_';
-        }
-
-        unsigned int color_code = color_to_uint(v.color);
-        if (k == assassin_id) {
-          color_code = color_to_uint(INVISIBLE);
-        }
+// the join handshake, built for one client and sent in a single write:
+// the game state, the client id and the running events. the map never
+// changes after the room is made, so its part is serialized once
+// (init_room_map), and players come from the room's join entries
+std::string join_entry_text(int id, const PlayerState &s) {
+  return netvent::val(id).serialize() + "=" +
+         player_state_delta(id, s, FIELD_ALL).serialize();
+}
 
-        out << ':' << k << ' ' << v.x << ' ' << v.y << ' ' << safe_username
-            << ' ' << color_code << ' ' << v.weapon_id;
+std::string build_join_burst(Room &room, const WorldSnapshot &world, int id,
+                             const Player &p, const PlayerLooks &looks,
+                             const std::string &token) {
+  std::string players = "{";
+  {
+    std::lock_guard<std::mutex> lock(room.join_mutex);
+    for (auto it = room.join_entries.begin(); it != room.join_entries.end();) {
+      if (world.players.count(it->first)) {
+        ++it;
+      } else {
+        it = room.join_entries.erase(it);
       }
     }
-
-    std::string lod = "";
-    {
-      netvent::Table players_table = netvent::map_table({});
-      // get players in a table
-      for (auto &[k, v] : game.players) {
-        players_table.push_back(netvent::val(k), v.to_table(k));
+    for (const auto &[k, s] : world.players) {
+      if (k == id)
+        continue;
+      auto entry = room.join_entries.find(k);
+      if (entry == room.join_entries.end()) {
+        entry = room.join_entries.insert({k, {s, join_entry_text(k, s)}}).first;
+      } else if (player_state_diff(entry->second.state, s)) {
+        entry->second = {s, join_entry_text(k, s)};
       }
-
-      EventType current_event = EventType::NOTHING;
-      bool assassin_active = assassin_id != -1;
-      if (darkness_active) {
-        current_event = EventType::Darkness;
-      } else if (acid_rain_active) {
-        current_event = EventType::AcidRain;
-      } else if (assassin_active) {
-        current_event = EventType::Assasin;
-      } 
-
-      std::map<std::string, netvent::Value> data = {
-          {"players", netvent::val(players_table)},
-          {"current_event", netvent::val(current_event)},
-          {"assassin_id", netvent::val(assassin_id)},
-          {"cubes", netvent::val(objects_to_table(cubes))}
-      };
-
-      lod = netvent::serialize_to_netvent(netvent::val(0 /* MSG_GAME_STATE */),
-                                          data);
+      players += entry->second.text;
+      players.push_back(',');
     }
-
-    send_message(lod, client);
-  } catch (const std::exception &e) {
-    std::cerr << "Client " << id << " error: " << e.what() << std::endl;
   }
-
-  std::string msg_id = netvent::serialize_to_netvent(
+  // our own player isn't published yet
+  players += netvent::val(id).serialize() + "=" + p.to_table(id, looks).serialize();
+  players.push_back('}');
+
+  EventType current_event = EventType::NOTHING;
+  bool assassin_active = world.assassin_id != -1;
+  if (world.darkness) {
+    current_event = EventType::Darkness;
+  } else if (world.acid_rain) {
+    current_event = EventType::AcidRain;
+  } else if (assassin_active) {
+    current_event = EventType::Assasin;
+  } 
+
+  std::string burst = netvent::serialize_to_netvent(
+      netvent::val(0 /* MSG_GAME_STATE */),
+      std::map<std::string, netvent::Value>(
+          {{"current_event", netvent::val(current_event)},
+           {"assassin_id", netvent::val(world.assassin_id)}}));
+  burst += netvent::serialized_field("players", players);
+  burst += room.join_static_fields;
+  burst.push_back(';');
+
+  int64_t server_time = sim_clock.now_ms();
+  burst += netvent::serialize_to_netvent(
       netvent::val(1 /* MSG_CLIENT_ID */),
-      std::map<std::string, netvent::Value>({{"id", netvent::val(id)}}));
-  send_message(msg_id, client);
-
-  std::cout << "Client " << msg_id << " has joined.\n";
-
-  // Send current event states to the new client
-  {
-    std::scoped_lock locks(darkness_mutex, acid_rain_mutex);
-
-    // Send darkness state if active
-    if (darkness_active) {
-      std::string event_msg = netvent::serialize_to_netvent(
-          netvent::val(MSG_EVENT_SUMMON),
-          std::map<std::string, netvent::Value>({
-              {"event_type", netvent::val(EventType::Darkness)}
-          }));
-      send_message(event_msg, client);
-      std::cout << "Sent darkness state to new client " << id << std::endl;
-    }
-
-    // send acid rain state if active
-    if (acid_rain_active) {
-      std::string event_msg = netvent::serialize_to_netvent(
-          netvent::val(MSG_EVENT_SUMMON),
-          std::map<std::string, netvent::Value>({
-              {"event_type", netvent::val(EventType::AcidRain)}
-          }));
-      send_message(event_msg, client);
-      std::cout << "Sent acid rain state to new client " << id << std::endl;
-    }
+      std::map<std::string, netvent::Value>(
+          {{"id", netvent::val(id)},
+           {"room", netvent::val(room.id)},
+           {"server_time_hi", netvent::val(time_hi(server_time))},
+           {"server_time_lo", netvent::val(time_lo(server_time))},
+           {"authoritative", netvent::val(authoritative_movement ? 1 : 0)},
+           {"token", netvent::val(token)}}));
+  burst.push_back(';');
+
+  // current event states
+  if (world.darkness) {
+    burst += netvent::serialize_to_netvent(
+        netvent::val(MSG_EVENT_SUMMON),
+        std::map<std::string, netvent::Value>({
+            {"event_type", netvent::val(EventType::Darkness)}
+        }));
+    burst.push_back(';');
   }
-
-  // if there's an active assassin, send the assassin event message to the new
-  // client
-  {
-    std::lock_guard<std::mutex> assassin_lock(assassin_mutex);
-    if (assassin_id != -1 && assassin_target_id != -1) {
-      std::string event_msg = netvent::serialize_to_netvent(
-          netvent::val(MSG_ASSASSIN_CHANGE),
-          std::map<std::string, netvent::Value>({
-              {"assassin_id", netvent::val(assassin_id)},
-              {"target_id", netvent::val(assassin_target_id)}
-          }));
-      send_message(event_msg, client);
-      std::cout << "Sent assassin state to new client " << id << std::endl;
-    }
+  if (world.acid_rain) {
+    burst += netvent::serialize_to_netvent(
+        netvent::val(MSG_EVENT_SUMMON),
+        std::map<std::string, netvent::Value>({
+            {"event_type", netvent::val(EventType::AcidRain)}
+        }));
+    burst.push_back(';');
+  }
+  if (world.assassin_id != -1 && world.assassin_target_id != -1) {
+    burst += netvent::serialize_to_netvent(
+        netvent::val(MSG_ASSASSIN_CHANGE),
+        std::map<std::string, netvent::Value>({
+            {"assassin_id", netvent::val(world.assassin_id)},
+            {"target_id", netvent::val(world.assassin_target_id)}
+        }));
+    burst.push_back(';');
   }
+  return burst;
+}
 
+// MSG_PLAYER_NEW, introduces a player to the others
+std::string player_new_message(int id, int x, int y, const std::string &username,
+                               Color color, int weapon_id) {
   // sanitize username for consistency
-  std::string safe_username = game.players.at(id).username;
+  std::string safe_username = username;
   if (safe_username.empty())
     safe_username = "unset";
   // remove bad characters
@@ -293,79 +821,354 @@ void handle_client(int client, int id) {
       c = '_';
   }
 
-  std::string out = netvent::serialize_to_netvent(
+  return netvent::serialize_to_netvent(
       netvent::val(3 /* MSG_PLAYER_NEW */),
       std::map<std::string, netvent::Value>(
           {{"id", netvent::val(id)},
-           {"x", netvent::val(game.players.at(id).x)},
-           {"y", netvent::val(game.players.at(id).y)},
+           {"x", netvent::val(x)},
+           {"y", netvent::val(y)},
            {"username", netvent::val(safe_username)},
-           {"color", netvent::val(color_to_table(game.players.at(id).color))},
-           {"weapon_id", netvent::val(game.players.at(id).weapon_id)}}));
+           {"color", netvent::val(color_to_table(color))},
+           {"weapon_id", netvent::val(weapon_id)}}));
+}
+
+// the resume handshake, instead of the join burst: who is in the room now
+// and the running events, and the players that came while the client was
+// away. the rest reaches it with the next snapshot, as a delta against the
+// last one it acked
+std::string build_resume_burst(Room &room, const WorldSnapshot &world, int id,
+                               const std::vector<int> &known) {
+  std::vector<netvent::Value> ids;
+  for (const auto &[k, s] : world.players)
+    ids.push_back(netvent::val(k));
+
+  int64_t server_time = sim_clock.now_ms();
+  std::string burst = netvent::serialize_to_netvent(
+      netvent::val(MSG_RESUMED),
+      std::map<std::string, netvent::Value>(
+          {{"id", netvent::val(id)},
+           {"room", netvent::val(room.id)},
+           {"server_time_hi", netvent::val(time_hi(server_time))},
+           {"server_time_lo", netvent::val(time_lo(server_time))},
+           {"players", netvent::val(netvent::Table(ids))},
+           {"darkness", netvent::val(world.darkness ? 1 : 0)},
+           {"acid_rain", netvent::val(world.acid_rain ? 1 : 0)},
+           {"assassin_id", netvent::val(world.assassin_id)},
+           {"target_id", netvent::val(world.assassin_target_id)}}));
+  burst.push_back(';');
+
+  for (const auto &[k, s] : world.players) {
+    if (k == id || std::find(known.begin(), known.end(), k) != known.end())
+      continue;
+    burst += player_new_message(k, s.x, s.y, s.username, s.color, s.weapon_id);
+    burst.push_back(';');
+  }
+  return burst;
+}
+
+// puts a connection's player into room and sends it the join burst. a
+// player coming from another room keeps its name, color and weapon
+void join_room(Room &room, int id, int client, const std::string &token,
+               const Player *carried = nullptr,
+               const PlayerLooks *carried_looks = nullptr) {
+  // everything but our own player comes from the last published tick, so a
+  // join never waits on the simulation. before the first tick it's empty
+  std::shared_ptr<const WorldSnapshot> world =
+      std::atomic_load(&room.published_world);
+  if (!world)
+    world = std::make_shared<WorldSnapshot>();
+
+  Player p(100, 100);
+  PlayerLooks looks;
+  if (carried)
+    p.weapon_id = carried->weapon_id;
+  if (carried_looks)
+    looks = *carried_looks;
+  try {
+    {
+      std::lock_guard<std::mutex> lock(room.game_mutex);
+      room.game.players.insert({id, p}, looks);
+    }
+
+    // first in our outbox, so it goes out with the room's next flush ahead
+    // of anything else for us. callers may hold the rooms lock, a slow
+    // client must not stall them in a send
+    std::string burst = build_join_burst(room, *world, id, p, looks, token);
+    std::lock_guard<std::mutex> clients_lock(room.clients_mutex);
+    room.clients[id] = std::make_pair(client, nullptr);
+    room.client_sessions[id] = next_session++;
+    room.outboxes[id].insert(0, burst);
+  } catch (const std::exception &e) {
+    std::cerr << "Client " << id << " error: " << e.what() << std::endl;
+  }
+
+  std::cout << "Client " << id << " has joined room " << room.id << ".\n";
+
+  std::string out =
+      player_new_message(id, p.x, p.y, looks.username, looks.color, p.weapon_id);
 
   {
-    std::lock_guard<std::mutex> clients_lock(clients_mutex);
-    for (auto &pair : clients) {
-      if (pair.first != id) {
-        send_message(out, pair.second.first);
-      }
+    // joins in the same tick reach everyone in one write
+    std::lock_guard<std::mutex> clients_lock(room.clients_mutex);
+    queue_broadcast_unlocked(room, out, id);
+  }
+}
+
+// takes a connection's player out of room, on disconnect or when it moves
+// to another room. returns the player as it was and fills looks, out of
+// assassin mode
+Player leave_room(Room &room, int id, PlayerLooks *looks = nullptr) {
+  std::scoped_lock all_locks(room.game_mutex, room.assassin_mutex,
+                             room.pending_assassin_mutex, room.clients_mutex);
+
+  Player left(100, 100);
+  PlayerLooks left_looks;
+  auto player = room.game.players.find(id);
+  if (player != room.game.players.end()) {
+    left = player->second;
+    left_looks = room.game.players.looks(id);
+  }
+
+  // Check if leaving player was assassin
+  if (id == room.assassin_id) {
+    std::cout << "Assassin (ID: " << id
+              << ") left. Ending assassin event." << std::endl;
+    left_looks.color = room.original_assassin_color;
+    clear_assassin_state_unlocked(room);
+  }
+
+  room.game.players.erase(id);
+  room.clients.erase(id);
+  room.client_sessions.erase(id);
+  room.client_rtt_ms.erase(id);
+  room.outboxes.erase(id);
+  room.input_buffers.erase(id);
+
+  // notify the others, goes out with the room's next tick
+  std::string out = netvent::serialize_to_netvent(
+      netvent::val(4 /* MSG_PLAYER_LEFT */),
+      std::map<std::string, netvent::Value>({{"id", netvent::val(id)}}));
+  queue_broadcast_unlocked(room, out, id);
+  if (looks)
+    *looks = left_looks;
+  return left;
+}
+
+// a recv can hold several messages (or part of one), queues the complete
+// ones in order
+void queue_received(Connection &connection, int handle) {
+  std::string &pending = connection.recv_buffer;
+  std::lock_guard<std::mutex> lock(packets_mutex);
+  size_t separator_pos;
+  while ((separator_pos = pending.find(';')) != std::string::npos) {
+    std::string packet = pending.substr(0, separator_pos);
+    pending.erase(0, separator_pos + 1);
+    if (!packet.empty()) {
+      packets.push_back({handle, packet});
     }
   }
+}
 
-  bool running;
+// the recv thread of a connection, once its player is in a room. the slot
+// stays ours until the main loop has joined the thread
+void receive_packets(int id) {
+  Connection &connection = connections[id];
+  int client = connection.socket;
+  int handle;
   {
-    std::lock_guard<std::mutex> _(running_mutex);
-    running = is_running[id];
+    std::lock_guard<std::mutex> lock(rooms_mutex);
+    handle = connections.handle(id);
   }
 
-  while (running) {
+  while (connection.running) {
     char buffer[1024];
 
     int received = recv_data(client, buffer, sizeof(buffer), 0);
 
+    // woken by a handoff, running says whether to go on
+    if (received < 0 && errno == EINTR)
+      continue;
     if (received <= 0)
       break;
+
+    connection.recv_buffer.append(buffer, received);
+    // stopped for a handoff: what's left goes to the next process as is
+    if (!connection.running)
+      break;
+    queue_received(connection, handle);
+  }
+
+  // a disconnect, the main loop takes the player out of its room
+  if (connection.running.exchange(false)) {
     {
-      std::lock_guard<std::mutex> _(running_mutex);
-      running = is_running[id];
+      std::lock_guard<std::mutex> lock(closed_mutex);
+      closed_connections.push_back(id);
+    }
+    std::cout << "Client " << id << " disconnected.\n";
+  }
+  connection.receiving = false;
+}
+
+// fills out with bytes from the system's CSPRNG, false if it has none
+bool secure_random(unsigned char *out, size_t size) {
+#if __unix__
+  while (size > 0) {
+    ssize_t got = getrandom(out, size, 0);
+    if (got < 0) {
+      if (errno == EINTR)
+        continue;
+      perror("getrandom failed");
+      return false;
+    }
+    out += got;
+    size -= (size_t)got;
+  }
+  return true;
+#else
+  // msvc's random_device is rand_s, which is a CSPRNG
+  std::random_device device;
+  for (size_t i = 0; i < size; i++)
+    out[i] = (unsigned char)device();
+  return true;
+#endif
+}
+
+// a token nobody has (rooms_mutex held). empty if there's no randomness to
+// make one from, the client then can't resume
+std::string new_resume_token_unlocked() {
+  static const char *HEX = "0123456789abcdef";
+  std::string token;
+  do {
+    unsigned char bytes[RESUME_TOKEN_BYTES];
+    if (!secure_random(bytes, sizeof(bytes)))
+      return "";
+    token.clear();
+    for (unsigned char b : bytes) {
+      token.push_back(HEX[b >> 4]);
+      token.push_back(HEX[b & 15]);
     }
+  } while (resume_tokens.count(token));
+  return token;
+}
 
-    if (!running)
+// the first thing a client sends is MSG_RESUME, with the token of the
+// player it had if it's coming back. waits RESUME_WAIT_MS for it, a client
+// that doesn't send one joins as new. returns the token, the message is
+// taken out of the buffer and anything after it stays
+std::string read_resume_token(Connection &connection) {
+  std::string &pending = connection.recv_buffer;
+  set_receive_timeout(connection.socket, RESUME_WAIT_MS);
+  while (connection.running && pending.find(';') == std::string::npos) {
+    char buffer[1024];
+    int received = recv_data(connection.socket, buffer, sizeof(buffer), 0);
+    // a timeout, or a disconnect receive_packets will see again
+    if (received <= 0)
       break;
+    pending.append(buffer, received);
+  }
+  set_receive_timeout(connection.socket, 0);
+
+  size_t separator_pos = pending.find(';');
+  if (separator_pos == std::string::npos)
+    return "";
+  try {
+    auto [event_name, data] =
+        netvent::deserialize_from_netvent(pending.substr(0, separator_pos));
+    if (event_name.as_int() != MSG_RESUME)
+      return "";
+    pending.erase(0, separator_pos + 1);
+    return data["token"].as_string();
+  } catch (const std::exception &) {
+    return "";
+  }
+}
 
+// moves connection id onto the parked connection token belongs to: same
+// player id and session, so the other clients see nothing and replication
+// goes on from what the client acked before it dropped. returns the id it
+// now has, -1 if the token is unknown or its player is gone
+int resume_connection(int id, const std::string &token) {
+  Connection &connection = connections[id];
+  for (int waited = 0;; waited += 10) {
     {
-      std::lock_guard<std::mutex> lock(packets_mutex);
-      packets.push_front({
-          id,
-          std::string(buffer, received),
-      });
+      std::scoped_lock locks(rooms_mutex, connections_mutex);
+      auto found = resume_tokens.find(token);
+      // stopped for a handoff, the new server can sort it out
+      if (found == resume_tokens.end() || found->second == id ||
+          !connection.running)
+        return -1;
+
+      int parked = found->second;
+      Connection &old = connections[parked];
+      if (old.parked_until_ms != -1) {
+        connection.room->members--;
+        connection.room.reset();
+        resume_tokens.erase(connection.resume_token);
+        connection.resume_token.clear();
+
+        // this thread goes on as the parked connection's
+        old.socket = connection.socket;
+        old.recv_buffer = std::move(connection.recv_buffer);
+        old.thread = std::move(connection.thread);
+        old.parked_until_ms = -1;
+        old.running = true;
+        old.receiving = true;
+        connection.socket = -1;
+        connection.running = false;
+        connection.receiving = false;
+        connections.release(id);
+
+        std::shared_ptr<const WorldSnapshot> world =
+            std::atomic_load(&old.room->published_world);
+        if (!world)
+          world = std::make_shared<WorldSnapshot>();
+        Room &room = *old.room;
+        // goes out with the room's next flush, not from under these locks.
+        // whatever was queued while parked was for the dead socket
+        std::string burst =
+            build_resume_burst(room, *world, parked, old.known_players);
+        old.known_players.clear();
+        std::lock_guard<std::mutex> clients_lock(room.clients_mutex);
+        room.clients[parked].first = old.socket;
+        room.outboxes[parked] = burst;
+        std::cout << "Client " << parked << " resumed in room " << room.id
+                  << std::endl;
+        return parked;
+      }
+
+      // the old connection hasn't noticed the drop yet: cut it, the main
+      // loop parks it
+      if (waited == 0 && old.socket != -1)
+        shutdown_socket(old.socket, SHUTDOWN_BOTH);
     }
+    if (waited >= RESUME_WAIT_MS)
+      return -1;
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
   }
+}
 
-  {
-    std::lock_guard<std::mutex> _(running_mutex);
-    is_running[id] = false;
-    std::lock_guard<std::mutex> _lock(game_mutex);
-    game.players.erase(id);
-
-    // Check if disconnected player was assassin
-    std::lock_guard<std::mutex> assassin_lock(assassin_mutex);
-    if (id == assassin_id) {
-      std::cout << "Assassin (ID: " << id
-                << ") disconnected. Ending assassin event." << std::endl;
-      if (game.players.count(id)) {
-        game.players.at(id).color = original_assassin_color;
-        std::ostringstream response;
-        response << "5\n" // MSG_PLAYER_UPDATE
-                 << id << " " << game.players.at(id).username << " "
-                 << color_to_uint(original_assassin_color);
-        broadcast_message(response.str(), clients);
-      }
-      clear_assassin_state_unlocked();
+void handle_client(int id) {
+  // accept filled the record in before starting this thread
+  Connection &connection = connections[id];
+  std::string token = read_resume_token(connection);
+  if (!token.empty()) {
+    int resumed = resume_connection(id, token);
+    if (resumed != -1) {
+      receive_packets(resumed);
+      return;
     }
   }
 
-  std::cout << "Client " << id << " disconnected.\n";
+  std::shared_ptr<Room> room;
+  {
+    std::lock_guard<std::mutex> lock(rooms_mutex);
+    room = connection.room;
+    token = connection.resume_token;
+  }
+  join_room(*room, id, connection.socket, token);
+  room.reset(); // the main loop moves us between rooms from here on
+
+  receive_packets(id);
 }
 
 float normalize_rotation(float rot) {
@@ -381,8 +1184,9 @@ float normalize_rotation(float rot) {
 //  EVENTS
 // ---------------------------------
 
-bool check_assassin_collision(int assassin_id, int target_id, int assassin_x,
-                              int assassin_y, float assassin_rot) {
+bool check_assassin_collision(Room &room, int assassin_id, int target_id,
+                              int assassin_x, int assassin_y,
+                              float assassin_rot) {
   if (assassin_id == -1 || target_id == -1)
     return false;
 
@@ -391,18 +1195,18 @@ bool check_assassin_collision(int assassin_id, int target_id, int assassin_x,
     return false;
 
   // only allow knife to hit other players
-  if (game.players[assassin_id].weapon_id != Weapon::gun_or_knife)
+  if (room.game.players[assassin_id].weapon_id != Weapon::gun_or_knife)
     return false;
 
   assassin_rot = normalize_rotation(assassin_rot + 180.0f);
 
   // null check
-  if (game.players.find(assassin_id) == game.players.end() ||
-      game.players.find(target_id) == game.players.end()) {
+  if (room.game.players.find(assassin_id) == room.game.players.end() ||
+      room.game.players.find(target_id) == room.game.players.end()) {
     return false;
   }
 
-  Player &target = game.players[target_id];
+  Player &target = room.game.players[target_id];
 
   float knife_offset = 80.0f;
   float angle_rad = assassin_rot * DEG2RAD;
@@ -421,23 +1225,24 @@ bool check_assassin_collision(int assassin_id, int target_id, int assassin_x,
   return distance <= hitbox_radius;
 }
 
-void select_new_target(int assassin_id, bool is_initial_target) {
+void select_new_target(Room &room, int assassin_id, bool is_initial_target) {
   std::vector<int> potential_targets;
-  for (const auto &[player_id, player] : game.players) {
+  for (const auto &[player_id, player] : room.game.players) {
+    const PlayerLooks &looks = room.game.players.looks(player_id);
     // don't target:
     // - the assassin themselves
     // - invisible players
     // - previously targeted players (unless we've targeted everyone)
-    if (player_id != assassin_id && !color_equal(player.color, INVISIBLE) &&
-        (previous_targets.find(player_id) == previous_targets.end() ||
-         previous_targets.size() >= game.players.size() - 1)) {
+    if (player_id != assassin_id && !color_equal(looks.color, INVISIBLE) &&
+        (room.previous_targets.find(player_id) == room.previous_targets.end() ||
+         room.previous_targets.size() >= room.game.players.size() - 1)) {
       potential_targets.push_back(player_id);
     }
   }
 
   if (!potential_targets.empty()) {
-    if (previous_targets.size() >= game.players.size() - 1) {
-      previous_targets.clear();
+    if (room.previous_targets.size() >= room.game.players.size() - 1) {
+      room.previous_targets.clear();
     }
 
     std::random_device rd;
@@ -448,85 +1253,154 @@ void select_new_target(int assassin_id, bool is_initial_target) {
 
     // add to previous targets
     if (!is_initial_target) {
-      previous_targets.insert(new_target_id);
+      room.previous_targets.insert(new_target_id);
     }
 
-    assassin_target_id = new_target_id;
+    room.assassin_target_id = new_target_id;
 
     // send assassin event message
     std::string event_response = netvent::serialize_to_netvent(
         netvent::val(MSG_ASSASSIN_CHANGE),
         std::map<std::string, netvent::Value>({
             {"assassin_id", netvent::val(assassin_id)},
-            {"target_id", netvent::val(assassin_target_id)}
+            {"target_id", netvent::val(room.assassin_target_id)}
         }));
 
-    auto assassin_client = clients.find(assassin_id);
-    if (assassin_client != clients.end()) {
-      send_message(event_response, assassin_client->second.first);
+    auto assassin_client = room.clients.find(assassin_id);
+    if (assassin_client != room.clients.end() &&
+        assassin_client->second.first != -1) {
+      queue_message_unlocked(room, event_response, assassin_id);
       if (is_initial_target) {
         std::cout << "New assassin " << assassin_id
-                  << " assigned initial target " << assassin_target_id
+                  << " assigned initial target " << room.assassin_target_id
                   << std::endl;
       } else {
         std::cout << "Assassin " << assassin_id << " assigned new target "
-                  << assassin_target_id << " after pending" << std::endl;
+                  << room.assassin_target_id << " after pending" << std::endl;
       }
     }
   }
 }
 
-void make_player_assassin(int target_id) {
-  std::scoped_lock all_locks(game_mutex, assassin_mutex, pending_assassin_mutex,
-                             clients_mutex);
+// timer callbacks, these run on the room's tick with no locks held
 
-  if (assassin_id != -1) {
-    std::cout << "Command failed: An assassin event is already active."
-              << std::endl;
+void end_darkness_event(Room &room) {
+  std::scoped_lock locks(room.darkness_mutex, room.clients_mutex);
+  if (!room.darkness_active) {
     return;
   }
+  room.darkness_active = false;
+  room.darkness_timer = -1;
 
-  if (game.players.find(target_id) == game.players.end()) {
-    std::cout << "Command failed: Player with ID " << target_id << " not found."
-              << std::endl;
+  // send clear event message to all clients
+  std::string res = netvent::serialize_to_netvent(netvent::val(MSG_EVENT_SUMMON), std::map<std::string, netvent::Value>({{"event_type", netvent::val(EventType::Clear)}}));
+  queue_broadcast_unlocked(room, res);
+
+  std::cout << "Darkness event ended after 60 seconds" << std::endl;
+}
+
+void end_acid_rain_event(Room &room) {
+  std::scoped_lock locks(room.acid_rain_mutex, room.clients_mutex);
+  if (!room.acid_rain_active) {
     return;
   }
+  room.acid_rain_active = false;
+  room.acid_rain_timer = -1;
 
-  // prevent consecutive assassin roles
-  if (target_id == last_assassin_id) {
-    std::cout << "Player " << target_id << " was the last assassin. Skipping."
-              << std::endl;
+  // send clear event message to all clients
+  std::string res = netvent::serialize_to_netvent(netvent::val(MSG_EVENT_SUMMON), std::map<std::string, netvent::Value>({{"event_type", netvent::val(EventType::Clear)}}));
+  queue_broadcast_unlocked(room, res);
+
+  std::cout << "Acid rain event ended after 60 seconds" << std::endl;
+}
+
+void end_assassin_event(Room &room) {
+  std::scoped_lock all_locks(room.game_mutex, room.assassin_mutex,
+                             room.pending_assassin_mutex, room.clients_mutex);
+  if (room.assassin_id == -1) {
     return;
   }
+  room.assassin_timer = -1;
 
-  // store assassin state
-  assassin_id = target_id;
-  original_assassin_color = game.players.at(target_id).color;
-  assassin_start_time = std::chrono::steady_clock::now();
+  std::cout << "Assassin event timed out after 60 seconds" << std::endl;
+  if (room.game.players.count(room.assassin_id)) {
+    room.game.players.looks(room.assassin_id).color = room.original_assassin_color;
+    room.game.players.at(room.assassin_id).dirty |= FIELD_COLOR;
 
-  std::cout << "Server: Storing original color for player " << target_id
-            << " as " << color_to_string(original_assassin_color) << std::endl;
+    std::string res = netvent::serialize_to_netvent(netvent::val(MSG_PLAYER_UPDATE), std::map<std::string, netvent::Value>({{"id", netvent::val(room.assassin_id)}, {"username", netvent::val(room.game.players.looks(room.assassin_id).username)}, {"color", netvent::val(color_to_table(room.original_assassin_color))}}));
 
-  // invis
-  Color old_color = game.players.at(target_id).color;
-  game.players.at(target_id).color = INVISIBLE;
+    queue_broadcast_unlocked(room, res);
+  }
+  clear_assassin_state_unlocked(room);
+}
 
-  std::cout << "Server: Player " << target_id << " color changed from "
-            << color_to_string(old_color) << " to INVISIBLE (assassin mode)"
+// the 5 second self-target period is over, pick a real target again
+void retarget_pending_assassin(Room &room, int id) {
+  std::scoped_lock all_locks(room.game_mutex, room.assassin_mutex,
+                             room.pending_assassin_mutex, room.clients_mutex);
+  if (room.pending_assassins.erase(id) == 0) {
+    return;
+  }
+
+  if (room.game.players.size() > 1) {
+    select_new_target(room, id, false);
+  }
+}
+
+void make_player_assassin(Room &room, int target_id) {
+  std::scoped_lock all_locks(room.game_mutex, room.assassin_mutex,
+                             room.pending_assassin_mutex, room.clients_mutex);
+
+  if (room.assassin_id != -1) {
+    std::cout << "Command failed: An assassin event is already active."
+              << std::endl;
+    return;
+  }
+
+  if (room.game.players.find(target_id) == room.game.players.end()) {
+    std::cout << "Command failed: Player with ID " << target_id << " not found."
+              << std::endl;
+    return;
+  }
+
+  // prevent consecutive assassin roles
+  if (target_id == room.last_assassin_id) {
+    std::cout << "Player " << target_id << " was the last assassin. Skipping."
+              << std::endl;
+    return;
+  }
+
+  // store assassin state
+  room.assassin_id = target_id;
+  room.original_assassin_color = room.game.players.looks(target_id).color;
+  room.assassin_timer = room.timers.schedule(
+      60 * 1000, [room = &room]() { end_assassin_event(*room); });
+
+  std::cout << "Server: Storing original color for player " << target_id
+            << " as " << color_to_string(room.original_assassin_color) << std::endl;
+
+  // invis
+  Color old_color = room.game.players.looks(target_id).color;
+  room.game.players.looks(target_id).color = INVISIBLE;
+  room.game.players.at(target_id).dirty |= FIELD_COLOR;
+
+  std::cout << "Server: Player " << target_id << " color changed from "
+            << color_to_string(old_color) << " to INVISIBLE (assassin mode)"
             << std::endl;
 
   // select new target
-  if (game.players.size() > 1) {
-    select_new_target(target_id, true);
+  if (room.game.players.size() > 1) {
+    select_new_target(room, target_id, true);
   }
 
   // send the color change message
-  std::string res = netvent::serialize_to_netvent(netvent::val(MSG_PLAYER_UPDATE), std::map<std::string, netvent::Value>({{"id", netvent::val(target_id)}, {"username", netvent::val(game.players.at(target_id).username)}, {"color", netvent::val(color_to_table(INVISIBLE))}}));
+  std::string res = netvent::serialize_to_netvent(netvent::val(MSG_PLAYER_UPDATE), std::map<std::string, netvent::Value>({{"id", netvent::val(target_id)}, {"username", netvent::val(room.game.players.looks(target_id).username)}, {"color", netvent::val(color_to_table(INVISIBLE))}}));
 
-  broadcast_message(res, clients);
+  queue_broadcast_unlocked(room, res);
 }
 
-void summon_event(int delay, EventType event_type = EventType::NOTHING) {
+void summon_event(Room &room, int delay,
+                  EventType event_type = EventType::NOTHING) {
   if (delay <= 70 && event_type == EventType::NOTHING) {
     return; // too short to summon an event (only applies to random events)
   }
@@ -536,14 +1410,15 @@ void summon_event(int delay, EventType event_type = EventType::NOTHING) {
 
   switch (event_type) {
   case EventType::Darkness: {
-    std::scoped_lock locks(darkness_mutex, clients_mutex);
-    if (!darkness_active) {
-      darkness_active = true;
-      darkness_start_time = std::chrono::steady_clock::now();
+    std::scoped_lock locks(room.darkness_mutex, room.clients_mutex);
+    if (!room.darkness_active) {
+      room.darkness_active = true;
+      room.darkness_timer = room.timers.schedule(
+          60 * 1000, [room = &room]() { end_darkness_event(*room); });
 
       // send a message to all clients to start the darkness event
       std::string res = netvent::serialize_to_netvent(netvent::val(MSG_EVENT_SUMMON), std::map<std::string, netvent::Value>({{"event_type", netvent::val(EventType::Darkness)}}));
-      broadcast_message(res, clients);
+      queue_broadcast_unlocked(room, res);
 
       std::cout << "Darkness event started" << std::endl;
     }
@@ -552,23 +1427,24 @@ void summon_event(int delay, EventType event_type = EventType::NOTHING) {
   case EventType::Assasin: {
     int target_id = -1;
     {
-      std::lock_guard<std::mutex> game_lock(game_mutex);
-      if (game.players.empty() || game.players.size() <= 2) {
+      std::lock_guard<std::mutex> game_lock(room.game_mutex);
+      if (room.game.players.empty() || room.game.players.size() <= 2) {
         std::cout << "Not enough players to start an assassin event."
                   << std::endl;
         break;
       }
 
-      if (used_assassin_ids.size() >= game.players.size()) {
+      if (room.used_assassin_ids.size() >= room.game.players.size()) {
         std::cout << "All players have been assassins. Resetting assassin pool."
                   << std::endl;
-        used_assassin_ids.clear();
+        room.used_assassin_ids.clear();
       }
 
       // find a player who hasn't been an assassin yet
       std::vector<int> available_players;
-      for (const auto &player : game.players) {
-        if (used_assassin_ids.find(player.first) == used_assassin_ids.end()) {
+      for (const auto &player : room.game.players) {
+        if (room.used_assassin_ids.find(player.first) ==
+            room.used_assassin_ids.end()) {
           available_players.push_back(player.first);
         }
       }
@@ -580,152 +1456,346 @@ void summon_event(int delay, EventType event_type = EventType::NOTHING) {
     }
 
     if (target_id != -1) {
-      make_player_assassin(target_id);
+      make_player_assassin(room, target_id);
     }
     break;
   }
   case EventType::Clear: {
-    std::scoped_lock locks(darkness_mutex, clients_mutex);
-    if (darkness_active) {
-      darkness_active = false;
+    std::scoped_lock locks(room.darkness_mutex, room.acid_rain_mutex,
+                           room.clients_mutex);
+    if (room.darkness_active) {
+      room.darkness_active = false;
+      room.timers.cancel(room.darkness_timer);
+      room.darkness_timer = -1;
     }
-    if (acid_rain_active) {
-      acid_rain_active = false;
+    if (room.acid_rain_active) {
+      room.acid_rain_active = false;
+      room.timers.cancel(room.acid_rain_timer);
+      room.acid_rain_timer = -1;
     }
     break;
   }
   case EventType::AcidRain: {
-    std::scoped_lock locks(acid_rain_mutex, clients_mutex);
+    std::scoped_lock locks(room.acid_rain_mutex, room.clients_mutex);
     std::cout << "Acid rain event started" << std::endl;
-    if (!acid_rain_active) {
-      acid_rain_active = true;
-      acid_rain_start_time = std::chrono::steady_clock::now();
+    if (!room.acid_rain_active) {
+      room.acid_rain_active = true;
+      room.acid_rain_timer = room.timers.schedule(
+          60 * 1000, [room = &room]() { end_acid_rain_event(*room); });
 
       // send a message to all clients to start the acid rain event
       std::string res = netvent::serialize_to_netvent(netvent::val(MSG_EVENT_SUMMON), std::map<std::string, netvent::Value>({{"event_type", netvent::val(EventType::AcidRain)}}));
-      broadcast_message(res, clients);
+      queue_broadcast_unlocked(room, res);
     }
     break;
   }
   };
 }
 
-void event_worker() {
-  std::random_device rd;
-  std::mt19937 rng(rd());
-  std::uniform_int_distribution<int> dist(0, 5 * 60 * 1000); // 0 to 5 min in ms
-
-  while (true) {
-    int delay = dist(rng); // pick when in the next 5 minutes to run
-
-    std::this_thread::sleep_for(std::chrono::milliseconds(delay));
-    summon_event(delay); // run at some point within the 5 min window
+// runs the assassin knife check for a player that just moved
+void check_assassin_move(Room &room, int from_id) {
+  bool collision_occurred = false;
+  int current_assassin_id = -1;
+  int current_target_id = -1;
 
-    int remaining = (5 * 60 * 1000) - delay;
-    std::this_thread::sleep_for(std::chrono::milliseconds(remaining));
+  // check assassin collision first
+  {
+    std::lock_guard<std::mutex> assassin_lock(room.assassin_mutex);
+    if (room.assassin_id == from_id && room.assassin_target_id != -1) {
+      current_assassin_id = room.assassin_id;
+      current_target_id = room.assassin_target_id;
+    }
   }
-}
-
-void check_pending_assassins() {
-  std::scoped_lock all_locks(game_mutex, assassin_mutex, pending_assassin_mutex,
-                             clients_mutex);
 
-  // check darkness event timeout (1 minute)
+  // check collision at the new position
   {
-    std::lock_guard<std::mutex> darkness_lock(darkness_mutex);
-    if (darkness_active) {
-      auto current_time = std::chrono::steady_clock::now();
-      auto darkness_duration = std::chrono::duration_cast<std::chrono::seconds>(
-                                   current_time - darkness_start_time)
-                                   .count();
+    std::lock_guard<std::mutex> z(room.game_mutex);
+    if (room.game.players.find(from_id) == room.game.players.end())
+      return;
+    const Player &p = room.game.players.at(from_id);
 
-      if (darkness_duration >= 60) {
-        darkness_active = false;
+    // check if this player is an assassin
+    if (current_assassin_id == from_id && current_target_id != -1) {
+      if (check_assassin_collision(room, current_assassin_id,
+                                   current_target_id, p.x, p.y, p.rot)) {
+        collision_occurred = true;
+      }
+    }
+  }
+
+  // handle assassination
+  if (collision_occurred) {
+    // ANDY SHALL HANDLE ASSASSIN DAMAGE HERE
+    // TODO: Implement assassin damage
+    std::cout << "ASSASSIN SUCCESS! Player "
+              << current_assassin_id << " hit target "
+              << current_target_id << std::endl;
+    // Store current assassin as last assassin
+    room.last_assassin_id = current_assassin_id;
+
+    // Set assassin to target themselves for 5 seconds
+    {
+      std::scoped_lock locks(room.game_mutex, room.assassin_mutex,
+                             room.pending_assassin_mutex,
+                             room.clients_mutex);
+      room.assassin_target_id = current_assassin_id; // Target self
+      auto pending = room.pending_assassins.find(current_assassin_id);
+      if (pending != room.pending_assassins.end()) {
+        room.timers.cancel(pending->second);
+      }
+      room.pending_assassins[current_assassin_id] = room.timers.schedule(
+          5 * 1000, [room = &room, id = current_assassin_id]() {
+            retarget_pending_assassin(*room, id);
+          });
 
-        // send clear event message to all clients
-        std::string res = netvent::serialize_to_netvent(netvent::val(MSG_EVENT_SUMMON), std::map<std::string, netvent::Value>({{"event_type", netvent::val(EventType::Clear)}}));
-        broadcast_message(res, clients);
+      // Notify assassin of self-targeting
+      std::string event_response = netvent::serialize_to_netvent(
+          netvent::val(MSG_ASSASSIN_CHANGE),
+          std::map<std::string, netvent::Value>({
+              {"assassin_id", netvent::val(current_assassin_id)},
+              {"target_id", netvent::val(current_assassin_id)}
+          }));
 
-        std::cout << "Darkness event ended after 60 seconds" << std::endl;
+      auto assassin_client = room.clients.find(current_assassin_id);
+      if (assassin_client != room.clients.end() &&
+          assassin_client->second.first != -1) {
+        queue_message_unlocked(room, event_response, current_assassin_id);
+        std::cout << "Assassin " << current_assassin_id
+                  << " entering pending period (self-target)"
+                  << std::endl;
       }
     }
   }
+}
 
-  // also check acid rain event timeout (1 minute)
+// authoritative movement up to the current sim tick
+void simulate_inputs(Room &room) {
+  std::vector<int> moved;
   {
-    std::lock_guard<std::mutex> acid_rain_lock(acid_rain_mutex);
-    if (acid_rain_active) {
-      auto current_time = std::chrono::steady_clock::now();
-      auto acid_rain_duration =
-          std::chrono::duration_cast<std::chrono::seconds>(current_time -
-                                                           acid_rain_start_time)
-              .count();
-
-      if (acid_rain_duration >= 60) {
-        acid_rain_active = false;
-
-        // send clear event message to all clients
-        std::string res = netvent::serialize_to_netvent(netvent::val(MSG_EVENT_SUMMON), std::map<std::string, netvent::Value>({{"event_type", netvent::val(EventType::Clear)}}));
-        broadcast_message(res, clients);
-
-        std::cout << "Acid rain event ended after 60 seconds" << std::endl;
+    std::lock_guard<std::mutex> lock(room.game_mutex);
+    int tick = sim_clock.tick();
+    int64_t now = sim_clock.now_ms();
+    if (room.last_move_tick == -1) {
+      room.last_move_tick = tick;
+    }
+
+    for (; room.last_move_tick < tick; room.last_move_tick++) {
+      for (auto &[id, buffer] : room.input_buffers) {
+        auto player = room.game.players.find(id);
+        if (player == room.game.players.end() || buffer.commands.empty()) {
+          buffer.draining = false; // starved, buffer up again
+          continue;
+        }
+
+        if (!buffer.draining) {
+          buffer.draining =
+              (int)buffer.commands.size() >= INPUT_BUFFER_TARGET ||
+              now - buffer.commands.front().arrived_ms >= INPUT_MAX_WAIT_MS;
+          if (!buffer.draining) {
+            continue;
+          }
+        }
+
+        const InputCommand &cmd = buffer.commands.front().cmd;
+        simulate_move(player->second, cmd.keys,
+                      room.map_chunks.cube_colliders_near(player->second.x,
+                                                          player->second.y));
+        player->second.rot = cmd.rot;
+        player->second.dirty |= FIELD_POS | FIELD_ROT;
+        buffer.last_seq = cmd.seq;
+        buffer.commands.pop_front();
+        moved.push_back(id);
       }
     }
   }
 
-  // make sure assassin event is under 1 min
-  if (assassin_id != -1) {
-    auto current_time = std::chrono::steady_clock::now();
-    auto event_duration = std::chrono::duration_cast<std::chrono::seconds>(
-                              current_time - assassin_start_time)
-                              .count();
+  std::sort(moved.begin(), moved.end());
+  moved.erase(std::unique(moved.begin(), moved.end()), moved.end());
+  for (int id : moved) {
+    check_assassin_move(room, id);
+  }
+}
 
-    if (event_duration >= 60) {
-      std::cout << "Assassin event timed out after 60 seconds" << std::endl;
-      if (game.players.count(assassin_id)) {
-        game.players.at(assassin_id).color = original_assassin_color;
+// picks when in the next 5 minute window to run a random event, then
+// schedules the window after it
+void schedule_event_window(Room *room) {
+  int delay = random_int(0, 5 * 60 * 1000);
+  room->timers.schedule(delay, [room, delay]() { summon_event(*room, delay); });
+  room->timers.schedule(5 * 60 * 1000, [room]() { schedule_event_window(room); });
+}
 
-        std::string res = netvent::serialize_to_netvent(netvent::val(MSG_PLAYER_UPDATE), std::map<std::string, netvent::Value>({{"id", netvent::val(assassin_id)}, {"username", netvent::val(game.players.at(assassin_id).username)}, {"color", netvent::val(color_to_table(original_assassin_color))}}));
+// ---------------------------------
+// END EVENTS
+// ---------------------------------
 
-        broadcast_message(res, clients);
-      }
-      clear_assassin_state_unlocked();
-      return;
-    }
+// ---------------------------------
+// ROOMS AND THE LOBBY
+// ---------------------------------
+
+// the room's map starts out empty, its chunks are built as they are needed
+// (load_chunk). creating a room runs under rooms_mutex and must stay cheap
+void init_room_map(Room &room) {
+  int count = world_chunks();
+  room.chunk_messages.assign(count * count, "");
+  room.cube_messages.assign(count * count, "");
+
+  room.join_static_fields = netvent::serialized_field(
+      "map_seed", netvent::val((int)room.map_seed).serialize());
+  room.join_static_fields += netvent::serialized_field(
+      "map_version", netvent::val(MAP_GEN_VERSION).serialize());
+  room.join_static_fields += netvent::serialized_field(
+      "world_tiles",
+      netvent::val((int)PLAYING_AREA.width / TILE_SIZE).serialize());
+}
+
+// id is only given when a handoff or checkpoint brings the room over
+std::shared_ptr<Room> create_room_unlocked(uint32_t seed, int id = -1) {
+  auto room = std::make_shared<Room>();
+  room->id = id == -1 ? next_room_id++ : id;
+  room->map_seed = seed;
+  init_room_map(*room);
+
+  room->timers.start(sim_clock.now_ms());
+  schedule_event_window(room.get());
+  Room *r = room.get();
+  room->timers.schedule(SNAPSHOT_INTERVAL_MS, [r]() { send_snapshots(r); });
+
+  rooms[room->id] = room;
+  std::cout << "Room " << room->id << " opened, map seed " << seed
+            << std::endl;
+  return room;
+}
+
+// where a new connection goes: the first room with space, else a new one.
+// once MAX_ROOMS are open the emptiest room takes it anyway
+std::shared_ptr<Room> quick_play_room_unlocked() {
+  std::shared_ptr<Room> emptiest;
+  for (const auto &[id, room] : rooms) {
+    if (room->members < room_size)
+      return room;
+    if (!emptiest || room->members < emptiest->members)
+      emptiest = room;
   }
+  if ((int)rooms.size() >= MAX_ROOMS)
+    return emptiest;
+  return create_room_unlocked(std::random_device{}());
+}
 
-  if (pending_assassins.empty()) {
-    return;
+std::shared_ptr<Room> find_room(int room_id) {
+  std::lock_guard<std::mutex> lock(rooms_mutex);
+  auto room = rooms.find(room_id);
+  return room == rooms.end() ? nullptr : room->second;
+}
+
+// MSG_ROOM_LIST: every open room and how many are in it
+std::string room_list_unlocked(int current) {
+  std::vector<netvent::Value> ids, players;
+  for (const auto &[id, room] : rooms) {
+    ids.push_back(netvent::val(id));
+    players.push_back(netvent::val(room->members));
   }
+  return netvent::serialize_to_netvent(
+      netvent::val(MSG_ROOM_LIST),
+      std::map<std::string, netvent::Value>(
+          {{"room", netvent::val(current)},
+           {"room_size", netvent::val(room_size)},
+           {"ids", netvent::val(netvent::Table(ids))},
+           {"players", netvent::val(netvent::Table(players))}}));
+}
 
-  std::vector<int> assassins_to_update;
-  auto current_time = std::chrono::steady_clock::now();
+// lobby messages. they move connections between rooms, so they're handled
+// by the main loop while no room ticks
+void handle_lobby_packet_unlocked(int from_id, int packet_type,
+                                  const std::string &payload) {
+  Connection &connection = connections[from_id];
+  std::shared_ptr<Room> from = connection.room;
+  if (!from)
+    return;
 
-  // check which assassins need new targets
-  for (const auto &[assassin_id, start_time] : pending_assassins) {
-    auto elapsed = std::chrono::duration_cast<std::chrono::seconds>(
-                       current_time - start_time)
-                       .count();
+  auto [event_name, data] = netvent::deserialize_from_netvent(payload);
+  if (event_name.as_int() != packet_type)
+    return;
 
-    if (elapsed >= 5) {
-      assassins_to_update.push_back(assassin_id);
+  std::shared_ptr<Room> to;
+  if (packet_type == MSG_ROOM_JOIN) {
+    int target = data["room"].as_int();
+    if (target == -1) {
+      if ((int)rooms.size() < MAX_ROOMS)
+        to = create_room_unlocked(std::random_device{}());
+    } else {
+      auto room = rooms.find(target);
+      if (room != rooms.end() && room->second->members < room_size)
+        to = room->second;
     }
   }
 
-  // remove and update assassins that finished pending
-  for (int assassin_id : assassins_to_update) {
-    pending_assassins.erase(assassin_id);
+  if (!to) {
+    // asked for the list, or the join didn't work out: the list says why
+    std::lock_guard<std::mutex> clients_lock(from->clients_mutex);
+    queue_message_unlocked(*from, room_list_unlocked(from->id), from_id);
+    return;
+  }
+  if (to == from)
+    return;
+
+  int client;
+  {
+    std::lock_guard<std::mutex> lock(connections_mutex);
+    client = connection.socket;
+  }
+
+  // whatever it sent the old room this tick is moot now
+  from->packets.remove_if(
+      [from_id](const std::pair<int, std::string> &packet) {
+        return packet.first == from_id;
+      });
+  from->members--;
+  to->members++;
+  connection.room = to;
+
+  std::cout << "Client " << from_id << " moves from room " << from->id
+            << " to room " << to->id << std::endl;
+  PlayerLooks carried_looks;
+  Player carried = leave_room(*from, from_id, &carried_looks);
+  join_room(*to, from_id, client, connection.resume_token, &carried,
+            &carried_looks);
+}
 
-    if (game.players.size() > 1) {
-      select_new_target(assassin_id, false);
+// hands this tick's packets to the rooms of their senders, in order
+void route_packets_unlocked() {
+  packetlist current_packets;
+  {
+    std::lock_guard<std::mutex> lock(packets_mutex);
+    current_packets.swap(packets);
+  }
+
+  for (auto &[handle, packet] : current_packets) {
+    // the sender may have left (and its id been handed out again) since
+    int from_id = connections.resolve(handle);
+    if (from_id == -1)
+      continue;
+    try {
+      int packet_type = std::stoi(packet.substr(0, packet.find('\n')));
+      if (packet_type == MSG_ROOM_LIST_REQUEST || packet_type == MSG_ROOM_JOIN) {
+        handle_lobby_packet_unlocked(from_id, packet_type, packet);
+        continue;
+      }
+    } catch (const std::exception &e) {
+      std::cerr << "Error processing packet: " << e.what() << std::endl;
+      continue;
     }
+
+    if (const std::shared_ptr<Room> &room = connections[from_id].room)
+      room->packets.push_back({from_id, std::move(packet)});
   }
 }
 
 // ---------------------------------
-// END EVENTS
+// END ROOMS AND THE LOBBY
 // ---------------------------------
 
+// the console. events go to room 0 unless another room is given, the
+// assassin command finds the player's room itself
 void handle_stdin_commands() {
   std::string line;
   while (std::getline(std::cin, line)) {
@@ -739,13 +1809,62 @@ void handle_stdin_commands() {
         std::cout << "Usage: assassin <player_id>" << std::endl;
         continue;
       }
-      make_player_assassin(target_id);
-    } else if (command == "darkness") {
-      summon_event(0, EventType::Darkness);
-    } else if (command == "clear") {
-      summon_event(0, EventType::Clear);
-    } else if (command == "acid_rain") {
-      summon_event(0, EventType::AcidRain);
+      std::shared_ptr<Room> room;
+      {
+        std::lock_guard<std::mutex> lock(rooms_mutex);
+        if (connections.in_use(target_id))
+          room = connections[target_id].room;
+      }
+      if (!room) {
+        std::cout << "Command failed: Player with ID " << target_id
+                  << " not found." << std::endl;
+        continue;
+      }
+      make_player_assassin(*room, target_id);
+    } else if (command == "darkness" || command == "clear" ||
+               command == "acid_rain") {
+      int room_id = 0;
+      iss >> room_id;
+      std::shared_ptr<Room> room = find_room(room_id);
+      if (!room) {
+        std::cout << "Command failed: No room " << room_id << std::endl;
+        continue;
+      }
+      if (command == "darkness") {
+        summon_event(*room, 0, EventType::Darkness);
+      } else if (command == "clear") {
+        summon_event(*room, 0, EventType::Clear);
+      } else {
+        summon_event(*room, 0, EventType::AcidRain);
+      }
+    } else if (command == "status") {
+      std::vector<std::shared_ptr<Room>> open;
+      {
+        std::lock_guard<std::mutex> lock(rooms_mutex);
+        for (const auto &[id, room] : rooms)
+          open.push_back(room);
+      }
+      std::cout << open.size() << " rooms, tick " << last_tick_us
+                << " us, replication " << last_replicate_us << " us"
+                << std::endl;
+      if (last_checkpoint_us >= 0) {
+        std::cout << "Checkpoint: copy " << last_capture_us << " us, write "
+                  << last_checkpoint_us << " us" << std::endl;
+      }
+      // the published ticks, no need to stop the simulation for it
+      for (const std::shared_ptr<Room> &room : open) {
+        std::shared_ptr<const WorldSnapshot> world =
+            std::atomic_load(&room->published_world);
+        if (!world) {
+          std::cout << "Room " << room->id << ": no tick published yet"
+                    << std::endl;
+          continue;
+        }
+        std::cout << "Room " << room->id << ": tick " << world->tick << " at "
+                  << world->time_ms << " ms: " << world->players.size()
+                  << " players, " << world->clients.size() << " clients, tick "
+                  << room->last_tick_us << " us" << std::endl;
+      }
     } else {
       std::cout << "Unknown command: " << command << std::endl;
     }
@@ -753,7 +1872,7 @@ void handle_stdin_commands() {
 }
 
 void accept_clients(int sock) {
-  while (server_running) {
+  while (server_running && accept_new) {
     int client = accept_connection(sock, nullptr, nullptr);
     if (!server_running)
       break;
@@ -765,149 +1884,1238 @@ void accept_clients(int sock) {
       continue;
     }
 
-    int id = 0;
-    while (server_running) {
-      int id_init = id;
-      {
-        std::lock_guard<std::mutex> game_lock(game_mutex);
-        for (auto &[k, v] : game.players)
-          if (id == k)
-            id++;
+    std::scoped_lock locks(rooms_mutex, connections_mutex);
+    // freed ids are handed out again first, so they stay small and the
+    // player store's index short
+    int id = server_running ? connections.acquire() : -1;
+    if (id == -1) {
+      if (server_running)
+        std::cerr << "Server full (" << connections.capacity()
+                  << " connections), refusing a client" << std::endl;
+      close_socket(client);
+      continue;
+    }
+
+    Connection &connection = connections[id];
+    connection.socket = client;
+    connection.running = true;
+    connection.receiving = true;
+    connection.recv_buffer.clear();
+    connection.room = quick_play_room_unlocked();
+    connection.room->members++;
+    connection.resume_token = new_resume_token_unlocked();
+    connection.parked_until_ms = -1;
+    if (!connection.resume_token.empty())
+      resume_tokens[connection.resume_token] = id;
+    connection.thread = std::thread(handle_client, id);
+  }
+  accepting = false;
+}
+
+void flush_bullet_events_unlocked(Room &room) {
+  if (room.tick_bullet_spawns.empty() && room.tick_bullet_hits.empty())
+    return;
+
+  std::vector<netvent::Value> ids, owners, xs, ys, vxs, vys, ticks, local_ids;
+  for (const Bullet &b : room.tick_bullet_spawns) {
+    ids.push_back(netvent::val(b.bullet_id));
+    local_ids.push_back(netvent::val(b.local_id));
+    owners.push_back(netvent::val(b.shotby_id));
+    xs.push_back(netvent::val(b.spawn_x));
+    ys.push_back(netvent::val(b.spawn_y));
+    vxs.push_back(netvent::val(b.vx));
+    vys.push_back(netvent::val(b.vy));
+    ticks.push_back(netvent::val(b.spawn_tick));
+  }
+  std::vector<netvent::Value> hit_ids, hit_players;
+  for (const BulletHit &hit : room.tick_bullet_hits) {
+    hit_ids.push_back(netvent::val(hit.bullet_id));
+    hit_players.push_back(netvent::val(hit.player_id));
+  }
+
+  std::string msg = netvent::serialize_to_netvent(
+      netvent::val(MSG_BULLET_BATCH),
+      std::map<std::string, netvent::Value>({
+          {"spawn_ids", netvent::val(netvent::Table(ids))},
+          {"spawn_local_ids", netvent::val(netvent::Table(local_ids))},
+          {"spawn_owners", netvent::val(netvent::Table(owners))},
+          {"spawn_xs", netvent::val(netvent::Table(xs))},
+          {"spawn_ys", netvent::val(netvent::Table(ys))},
+          {"spawn_vxs", netvent::val(netvent::Table(vxs))},
+          {"spawn_vys", netvent::val(netvent::Table(vys))},
+          {"spawn_ticks", netvent::val(netvent::Table(ticks))},
+          {"hit_ids", netvent::val(netvent::Table(hit_ids))},
+          {"hit_players", netvent::val(netvent::Table(hit_players))}
+      }));
+  queue_broadcast_unlocked(room, msg);
+
+  room.tick_bullet_spawns.clear();
+  room.tick_bullet_hits.clear();
+}
+
+// what happened to a bullet this tick: kept, gone on static geometry, or
+// the id of the player it hit
+const int BULLET_KEEP = -2;
+const int BULLET_BLOCKED = -1;
+
+// steps one bullet up to tick, one tick at a time so nothing tunnels through
+// a cube or player. only reads shared state, safe to run in parallel
+int step_bullet_unlocked(Room &room, Bullet &b, int tick) {
+  while (b.tick < tick) {
+    b.step();
+
+    // check player collisions where the shooter saw them (the shooter
+    // can't hit themselves)
+    const HistoryFrame &frame = room.player_history.at(b.tick - b.rewind_ticks);
+    Rectangle bullet_rect = b.rect();
+    for (int p = aabb_first_hit(bullet_rect, frame.boxes); p >= 0;
+         p = aabb_first_hit(bullet_rect, frame.boxes, p + 1)) {
+      if (frame.ids[p] != b.shotby_id &&
+          room.game.players.count(frame.ids[p])) {
+        return frame.ids[p];
       }
+    }
 
-      if (id_init == id)
-        break;
+    // map edge and static objects, clients predict these on their own
+    if (bullet_blocked(b, room.map_chunks.static_colliders_near(b.x, b.y))) {
+      return BULLET_BLOCKED;
     }
+  }
+  return BULLET_KEEP;
+}
 
-    std::lock_guard<std::mutex> lock(clients_mutex);
-    if (server_running) {
-      clients[id] = std::make_pair(
-          client, std::make_shared<std::thread>(handle_client, client, id));
+void update_bullets(Room &room) {
+  std::scoped_lock locks(room.game_mutex, room.clients_mutex);
 
-      std::lock_guard<std::mutex> _(running_mutex);
-      is_running[id] = true;
-    } else {
-      close_socket(client);
+  int tick = sim_clock.tick();
+  room.player_history.record(tick, room.game.players);
+
+  // bullets are stepped in parallel, each job only writes its own bullets
+  // and outcome slots. despawns are applied afterwards in index order
+  size_t count = room.game.bullets.size();
+  room.bullet_outcomes.assign(count, BULLET_KEEP);
+  jobs.parallel_for(count, BULLET_JOB_GRAIN, [&room, tick](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; i++)
+      room.bullet_outcomes[i] =
+          step_bullet_unlocked(room, room.game.bullets.dense_at(i), tick);
+  });
+
+  for (size_t i = 0; i < count; i++) {
+    if (room.bullet_outcomes[i] >= 0)
+      room.tick_bullet_hits.push_back(
+          {room.game.bullets.dense_at(i).bullet_id, room.bullet_outcomes[i]});
+  }
+  // from the back, so the bullet swapped into a freed slot was already handled
+  for (size_t i = count; i-- > 0;) {
+    if (room.bullet_outcomes[i] != BULLET_KEEP)
+      room.game.bullets.erase_dense(i);
+  }
+
+  flush_bullet_events_unlocked(room);
+}
+
+// chunk (cx, cy) of the room's map, built with its MSG_CHUNK the first time
+// anything needs it. the chunk must be in the world. tick only, like every
+// other use of map_chunks
+const Chunk &load_chunk(Room &room, int cx, int cy) {
+  if (const Chunk *loaded = room.map_chunks.find(cx, cy))
+    return *loaded;
+
+  int index = cy * world_chunks() + cx;
+  Chunk chunk;
+  chunk.x = cx;
+  chunk.y = cy;
+  chunk.objects = landmark_chunks[index];
+  chunk.cubes = chunk_cubes(room.map_seed, cx, cy, objects);
+  room.chunk_messages[index] =
+      netvent::serialize_to_netvent(
+          netvent::val(MSG_CHUNK),
+          std::map<std::string, netvent::Value>(
+              {{"x", netvent::val(cx)},
+               {"y", netvent::val(cy)},
+               {"cubes_checksum",
+                netvent::val((int)cubes_checksum(chunk.cubes))}})) +
+      netvent::serialized_field("objects", landmark_tables[index]);
+  room.map_chunks.put(std::move(chunk));
+  return *room.map_chunks.find(cx, cy);
+}
+
+// the chunks around everything that collides with the map this tick, so
+// the near colliders of where they are include all their neighbours
+void load_active_chunks(Room &room) {
+  std::lock_guard<std::mutex> lock(room.game_mutex);
+  int last_cx = INT_MIN, last_cy = INT_MIN;
+  auto around = [&](float x, float y) {
+    int px = chunk_of(x), py = chunk_of(y);
+    if (px == last_cx && py == last_cy)
+      return;
+    last_cx = px;
+    last_cy = py;
+    for (int cy = py - 1; cy <= py + 1; cy++) {
+      for (int cx = px - 1; cx <= px + 1; cx++) {
+        if (chunk_in_world(cx, cy))
+          load_chunk(room, cx, cy);
+      }
     }
+  };
+  for (const auto &[id, p] : room.game.players)
+    around((float)p.x, (float)p.y);
+  for (size_t i = 0; i < room.game.bullets.size(); i++) {
+    const Bullet &b = room.game.bullets.dense_at(i);
+    around((float)b.x, (float)b.y);
   }
 }
 
-void init_server_objects() {
-  std::lock_guard<std::mutex> lock(objects_mutex);
+// whether a client may ask for chunk (cx, cy): only chunks around its
+// player, with some slack for lag
+bool chunk_near_player(Room &room, int id, int cx, int cy) {
+  if (!chunk_in_world(cx, cy))
+    return false;
+  std::lock_guard<std::mutex> game_lock(room.game_mutex);
+  auto player = room.game.players.find(id);
+  return player != room.game.players.end() &&
+         std::abs(chunk_of(player->second.x) - cx) <= CHUNK_EVICT_RADIUS &&
+         std::abs(chunk_of(player->second.y) - cy) <= CHUNK_EVICT_RADIUS;
+}
 
-  // Initialize basic map objects without textures since server doesn't render
-  const int BARREL_SIZE = 50;
-  const int BARREL_COLLISION_SIZE = BARREL_SIZE * 2;
+// this tick's packets of the room's clients
+void process_packets(Room &room) {
+  // only the newest move of each player this tick matters
+  static const std::string move_prefix = std::to_string(MSG_PLAYER_MOVE) + "\n";
+  std::unordered_map<int, const std::string *> latest_move;
+  for (const auto &[from_id, packet] : room.packets) {
+    if (packet.compare(0, move_prefix.size(), move_prefix) == 0) {
+      latest_move[from_id] = &packet;
+    }
+  }
 
-  // Add barrel
-  objects.push_back(
-      Object({(PLAYING_AREA.width / 2) - (BARREL_COLLISION_SIZE / 2),
-              (PLAYING_AREA.height / 2) - (BARREL_COLLISION_SIZE / 2),
-              BARREL_COLLISION_SIZE, BARREL_COLLISION_SIZE},
-             WHITE, // Color doesn't matter on server
-             ObjectType::Barrel));
+  for (const auto &[from_id, packet] : room.packets) {
+    try {
+      if (packet.empty())
+        continue;
+      if (packet.compare(0, move_prefix.size(), move_prefix) == 0 &&
+          latest_move[from_id] != &packet)
+        continue;
 
-  // Add charging stations
-  const int CHARGE_SIZE = 64;
-  const int CHARGE_OFFSET = 32;
+      int packet_type = std::stoi(packet.substr(0, packet.find('\n')));
+      std::string payload = packet; // if we substr the newline, the processing will break
+
+      switch (packet_type) {
+      case 2: {
+        if (authoritative_movement)
+          break; // positions come from input commands
+
+        // get the movement data
+        auto [event_name, data] =
+            netvent::deserialize_from_netvent(payload);
+        if (event_name.as_int() == 2) {
+          int x = data["x"].as_int();
+          int y = data["y"].as_int();
+          float rot = data["rot"].as_float();
+
+          {
+            std::lock_guard<std::mutex> z(room.game_mutex);
+            if (room.game.players.find(from_id) == room.game.players.end())
+              break;
+            room.game.players.at(from_id).x = x;
+            room.game.players.at(from_id).y = y;
+            room.game.players.at(from_id).rot = rot;
+            room.game.players.at(from_id).dirty |= FIELD_POS | FIELD_ROT;
+          }
 
-  // Add all four chargers
-  objects.push_back(
-      Object({CHARGE_OFFSET, (PLAYING_AREA.height / 2) - CHARGE_OFFSET,
-              CHARGE_SIZE, CHARGE_SIZE},
-             WHITE, ObjectType::Charger));
+          check_assassin_move(room, from_id);
 
-  objects.push_back(Object({PLAYING_AREA.width - CHARGE_OFFSET - CHARGE_SIZE,
-                            (PLAYING_AREA.height / 2) - CHARGE_OFFSET,
-                            CHARGE_SIZE, CHARGE_SIZE},
-                           WHITE, ObjectType::Charger));
+        }
+      } break;
+      case 5: { // MSG_PLAYER_UPDATE
+        auto [event_name, data] =
+            netvent::deserialize_from_netvent(payload);
+        if (event_name.as_int() == 5) {
+          std::string username = data["username"].as_string();
+          netvent::Table color_table = data["color"].as_table();
+
+          std::string sanitized_user = sanitize_username(username);
+
+          std::scoped_lock locks(room.game_mutex, room.clients_mutex);
+          room.game.players[from_id].dirty |= FIELD_USERNAME | FIELD_COLOR;
+          PlayerLooks &looks = room.game.players.looks(from_id);
+          looks.username = sanitized_user;
+          looks.color = color_from_table(color_table);
+
+          std::string response = netvent::serialize_to_netvent(
+              netvent::val(5 /* MSG_PLAYER_UPDATE */),
+              std::map<std::string, netvent::Value>(
+                  {{"id", netvent::val(from_id)},
+                   {"username", netvent::val(sanitized_user)},
+                   {"color", netvent::val(color_to_table(looks.color))}}));
+          queue_broadcast_unlocked(room, response, from_id);
+        }
+      } break;
+      case 6: {
+        auto [event_name, data] = netvent::deserialize_from_netvent(payload);
+        if (event_name.as_int() == 6) {
+          unsigned int color_code = data["color_code"].as_int();
+
+          std::scoped_lock locks(room.game_mutex, room.clients_mutex);
 
-  objects.push_back(Object({(PLAYING_AREA.width / 2) - CHARGE_OFFSET,
-                            CHARGE_OFFSET, CHARGE_SIZE, CHARGE_SIZE},
-                           WHITE, ObjectType::Charger));
+          room.game.players[from_id].dirty |= FIELD_COLOR;
+          room.game.players.looks(from_id).color = uint_to_color(color_code);
 
-  objects.push_back(Object({(PLAYING_AREA.width / 2) - CHARGE_OFFSET,
-                            PLAYING_AREA.height - CHARGE_OFFSET - CHARGE_SIZE,
-                            CHARGE_SIZE, CHARGE_SIZE},
-                           WHITE, ObjectType::Charger));
+          std::string out = netvent::serialize_to_netvent(
+              netvent::val(6),
+              std::map<std::string, netvent::Value>({
+                  {"player_id", netvent::val(from_id)},
+                  {"color_code", netvent::val((int)color_code)}
+              }));
+          queue_broadcast_unlocked(room, out, from_id);
+        }
+      } break;
+      case 10: {
+        auto [event_name, data] =
+            netvent::deserialize_from_netvent(payload);
+        if (event_name.as_int() == 10) {
+          float rot = data["rot"].as_float();
+
+          std::scoped_lock locks(room.game_mutex, room.clients_mutex);
+
+          float angleRad = (-rot + 5) * DEG2RAD;
+
+          Vector2 spawnOffset = Vector2Scale({cosf(angleRad), -sinf(angleRad)}, -120);
+          Vector2 origin = {(float)room.game.players[from_id].x + 50,
+                            (float)room.game.players[from_id].y + 50};
+          Vector2 spawnPos = Vector2Add(origin, spawnOffset);
+
+          // the shooter already drew the bullet from the tick it fired
+          // on, start ours there too so both copies line up. that tick
+          // only counts as far back as we rewind for this client, and
+          // the backdating eats into the rewind of the hit checks
+          int now_tick = sim_clock.tick();
+          int rewind = rewind_ticks_unlocked(room, from_id);
+          int fire_tick = now_tick;
+          if (data.find("tick") != data.end()) {
+            // no earlier than the first tick, right after startup there
+            // is less to rewind into
+            fire_tick = std::clamp(data["tick"].as_int(),
+                                   std::max(0, now_tick - rewind), now_tick);
+          }
+          int local_id = -1;
+          if (data.find("local_id") != data.end())
+            local_id = data["local_id"].as_int();
+
+          int vx, vy;
+          bullet_velocity(rot, &vx, &vy);
+          int bullet_id = room.game.bullets.insert(
+              Bullet((int)spawnPos.x, (int)spawnPos.y, vx, vy,
+                     fire_tick, from_id));
+          if (bullet_id == -1)
+            break; // out of bullet slots, the shooter's copy times out
+          Bullet *b = room.game.bullets.get(bullet_id);
+          b->bullet_id = bullet_id;
+          b->local_id = local_id;
+          b->rewind_ticks = rewind - (now_tick - fire_tick);
+
+          room.tick_bullet_spawns.push_back(*room.game.bullets.get(bullet_id));
+        }
+      } break;
+      case 12: { // MSG_SWITCH_WEAPON
+        auto [event_name, data] =
+            netvent::deserialize_from_netvent(payload);
+        if (event_name.as_int() == 12) {
+          int player_id = data["player_id"].as_int();
+          int weapon_id = data["weapon_id"].as_int();
+
+          // goes out with the next snapshot
+          std::lock_guard<std::mutex> lock(room.game_mutex);
+          if (room.game.players.find(player_id) != room.game.players.end()) {
+            room.game.players[player_id].weapon_id = weapon_id;
+            room.game.players[player_id].dirty |= FIELD_WEAPON;
+          }
+        }
+      } break;
+      case MSG_PLAYER_INPUT: {
+        auto [event_name, data] =
+            netvent::deserialize_from_netvent(payload);
+        if (event_name.as_int() == MSG_PLAYER_INPUT &&
+            authoritative_movement) {
+          auto seqs = data["seqs"].as_table().get_data_vector();
+          auto keys = data["keys"].as_table().get_data_vector();
+          auto rots = data["rots"].as_table().get_data_vector();
+          int64_t now = sim_clock.now_ms();
+
+          std::lock_guard<std::mutex> lock(room.game_mutex);
+          InputBuffer &buffer = room.input_buffers[from_id];
+          for (size_t i = 0; i < seqs.size() && i < keys.size() &&
+                             i < rots.size();
+               i++) {
+            int newest = buffer.commands.empty()
+                             ? buffer.last_seq
+                             : buffer.commands.back().cmd.seq;
+            InputCommand cmd;
+            cmd.seq = seqs[i].as_int();
+            cmd.keys = keys[i].as_int();
+            cmd.rot = rots[i].as_float();
+            if (cmd.seq > newest) {
+              buffer.commands.push_back({cmd, now});
+              if ((int)buffer.commands.size() > INPUT_BUFFER_MAX)
+                buffer.commands.pop_front();
+            }
+          }
+        }
+      } break;
+      case MSG_SNAPSHOT_ACK: {
+        auto [event_name, data] =
+            netvent::deserialize_from_netvent(payload);
+        if (event_name.as_int() == MSG_SNAPSHOT_ACK) {
+          int seq = data["seq"].as_int();
+          // only seqs this room has published, the rest can't be indexed
+          if (seq < 0 || seq >= room.snapshot_seq)
+            break;
+
+          std::lock_guard<std::mutex> clients_lock(room.clients_mutex);
+          auto session = room.client_sessions.find(from_id);
+          if (session == room.client_sessions.end())
+            break;
+          const PublishedSeq &published = room.published_ms[seq % SNAPSHOT_RING];
+          if (published.seq == seq) {
+            int sample = (int)(sim_clock.now_ms() - published.time_ms);
+            auto rtt = room.client_rtt_ms.find(from_id);
+            if (rtt == room.client_rtt_ms.end())
+              room.client_rtt_ms[from_id] = sample;
+            else
+              rtt->second = (rtt->second * 7 + sample) / 8;
+          }
+
+          // the baseline belongs to the replication thread
+          std::lock_guard<std::mutex> replication_lock(replication_mutex);
+          room.pending_acks.push_back({from_id, session->second, seq});
+        }
+      } break;
+      case MSG_CHUNK_REQUEST: {
+        auto [event_name, data] =
+            netvent::deserialize_from_netvent(payload);
+        if (event_name.as_int() == MSG_CHUNK_REQUEST) {
+          int cx = data["x"].as_int();
+          int cy = data["y"].as_int();
+          if (!chunk_near_player(room, from_id, cx, cy))
+            break;
+          load_chunk(room, cx, cy);
+
+          std::lock_guard<std::mutex> clients_lock(room.clients_mutex);
+          queue_message_unlocked(
+              room, room.chunk_messages[cy * world_chunks() + cx], from_id);
+        }
+      } break;
+      case MSG_MAP_REQUEST: {
+        // the client couldn't rebuild a chunk's cubes from the seed
+        auto [event_name, data] =
+            netvent::deserialize_from_netvent(payload);
+        if (event_name.as_int() == MSG_MAP_REQUEST) {
+          int cx = data["x"].as_int();
+          int cy = data["y"].as_int();
+          if (!chunk_near_player(room, from_id, cx, cy))
+            break;
+          const Chunk &chunk = load_chunk(room, cx, cy);
+          std::cout << "Client " << from_id << " asked for the cubes of chunk "
+                    << cx << "," << cy << std::endl;
+          std::string &cubes_msg = room.cube_messages[cy * world_chunks() + cx];
+          if (cubes_msg.empty()) {
+            cubes_msg = netvent::serialize_to_netvent(
+                netvent::val(MSG_MAP_CUBES),
+                std::map<std::string, netvent::Value>(
+                    {{"x", netvent::val(cx)},
+                     {"y", netvent::val(cy)},
+                     {"cubes", netvent::val(objects_to_table(chunk.cubes))}}));
+          }
+          std::lock_guard<std::mutex> clients_lock(room.clients_mutex);
+          queue_message_unlocked(room, cubes_msg, from_id);
+        }
+      } break;
+      default:
+        std::cerr << "INVALID PACKET TYPE: " << packet_type << std::endl;
+        break;
+      }
+    } catch (const std::exception &e) {
+      std::cerr << "Error processing packet: " << e.what() << std::endl;
+    }
+  }
+  room.packets.clear();
 }
 
-void update_bullets() {
-  std::scoped_lock locks(game_mutex, clients_mutex, objects_mutex);
+// one tick of one room. rooms tick in parallel, each as one job
+void tick_room(Room &room) {
+  auto tick_start = std::chrono::steady_clock::now();
 
-  auto it = game.bullets.begin();
-  while (it != game.bullets.end()) {
-    bool should_despawn = false;
+  // run expired timers
+  room.timers.advance(sim_clock.now_ms());
 
-    // Move bullet
-    it->move();
+  process_packets(room);
+  load_active_chunks(room);
 
-    // Check map boundaries
-    if (it->x < 0 || it->x > PLAYING_AREA.width || it->y < 0 ||
-        it->y > PLAYING_AREA.height) {
-      should_despawn = true;
-    }
+  // authoritative movement
+  if (authoritative_movement) {
+    simulate_inputs(room);
+  }
 
-    // check player collisions
-    if (!should_despawn) {
-      Rectangle bullet_rect = {(float)it->x, (float)it->y, it->r * 2,
-                               it->r * 2};
+  // update bullets
+  update_bullets(room);
 
-      for (const auto &[player_id, player] : game.players) {
-        if (player_id == it->shotby_id)
-          continue;
+  // hand the result to replication and other readers
+  publish_world(room);
+  room.last_tick_us = (int)std::chrono::duration_cast<std::chrono::microseconds>(
+                          std::chrono::steady_clock::now() - tick_start)
+                          .count();
+
+  // everything queued this tick (and by replication since the last one)
+  // goes out now
+  flush_outboxes(room);
+}
+
+// terminate disconnected clients
+// a dropped client's player stays in the game without a socket, and its
+// replication state with it, for the client to resume
+void park_connection_unlocked(int id) {
+  Connection &connection = connections[id];
+  Room &room = *connection.room;
+  std::scoped_lock locks(room.game_mutex, room.clients_mutex);
+  connection.known_players.clear();
+  for (const auto &[player_id, p] : room.game.players)
+    connection.known_players.push_back(player_id);
+  connection.parked_until_ms = steady_now_ms() + RESUME_GRACE_MS;
+  auto c = room.clients.find(id);
+  if (c != room.clients.end())
+    c->second.first = -1;
+}
+
+// parked players whose client didn't come back in time leave for good
+void expire_parked_connections() {
+  int64_t now = steady_now_ms();
+  std::scoped_lock locks(rooms_mutex, connections_mutex);
+  std::vector<int> expired;
+  for (const auto &[token, id] : resume_tokens) {
+    int64_t until = connections[id].parked_until_ms;
+    if (until != -1 && now >= until)
+      expired.push_back(id);
+  }
+  for (int id : expired) {
+    Connection &connection = connections[id];
+    connection.room->members--;
+    leave_room(*connection.room, id);
+    connection.room.reset();
+    resume_tokens.erase(connection.resume_token);
+    connection.resume_token.clear();
+    connection.parked_until_ms = -1;
+    connection.known_players.clear();
+    connections.release(id);
+    std::cout << "Client " << id << " didn't come back, removed" << std::endl;
+  }
+}
+
+void remove_disconnected_clients() {
+  std::vector<int> to_remove;
+  {
+    std::lock_guard<std::mutex> lock(closed_mutex);
+    to_remove.swap(closed_connections);
+  }
+
+  for (int i : to_remove) {
+    try {
+      Connection &connection = connections[i];
+      int socket_fd = connection.socket;
 
-        Rectangle player_rect = {(float)player.x, (float)player.y, 100, 100};
-        if (CheckCollisionRecs(bullet_rect, player_rect)) {
-          should_despawn = true;
-          break;
+      if (connection.thread.joinable()) {
+        if (socket_fd != -1) {
+          shutdown_socket(socket_fd, SHUTDOWN_BOTH);
         }
+
+        connection.thread.join();
       }
-    }
 
-    // Check collisions with map objects
-    if (!should_despawn) {
-      Rectangle bullet_rect = {(float)it->x, (float)it->y, it->r * 2,
-                               it->r * 2};
-      for (auto &obj : objects) {
-        if (obj.check_collision(bullet_rect)) {
-          should_despawn = true;
-          break;
+      // out of its room before the socket closes, so the room never writes
+      // to a closed (or reused) descriptor. the player stays, parked, until
+      // its client resumes or RESUME_GRACE_MS are up. the socket is let go
+      // in the same section: once parked, a resume may install a new one.
+      // without a token (no randomness at accept) nobody could resume it,
+      // and expiry only finds players by their token, so it leaves now
+      bool parked = false;
+      {
+        std::scoped_lock locks(rooms_mutex, connections_mutex);
+        if (connection.room && server_running &&
+            !connection.resume_token.empty()) {
+          park_connection_unlocked(i);
+          parked = true;
+        } else if (connection.room) {
+          connection.room->members--;
+          leave_room(*connection.room, i);
+          connection.room.reset();
         }
+        connection.socket = -1;
+      }
+
+      if (socket_fd != -1) {
+        close_socket(socket_fd);
+      }
+
+      // the id is free again only now, packets still carrying the old
+      // handle are dropped from here on
+      if (!parked) {
+        std::scoped_lock locks(rooms_mutex, connections_mutex);
+        resume_tokens.erase(connection.resume_token);
+        connection.resume_token.clear();
+        connections.release(i);
       }
 
-      for (auto &cube : cubes) {
-        if (cube.check_collision(bullet_rect)) {
-          should_despawn = true;
-          break;
+      if (parked) {
+        std::cout << "Client " << i << " parked for "
+                  << RESUME_GRACE_MS / 1000 << " s" << std::endl;
+      } else {
+        std::cout << "Removed client " << i << std::endl;
+      }
+    } catch (const std::exception &e) {
+      std::cerr << "Error cleaning up client " << i << ": " << e.what()
+                << std::endl;
+    }
+  }
+}
+
+// ---------------------------------
+// SAVED STATE
+// what a hot restart hands over and a checkpoint keeps: a copy of the
+// rooms taken between ticks, and the records it's written as (the
+// HANDOFF_* records, see handoff.hpp)
+// ---------------------------------
+
+struct RoomState {
+  int id = 0;
+  uint32_t seed = 0;
+  int snapshot_seq = 0;
+  int darkness_ms = -1; // time left, -1 when off
+  int acid_rain_ms = -1;
+  int assassin_id = -1;
+  int assassin_target_id = -1;
+  int assassin_ms = -1;
+  Color assassin_color;
+  int last_assassin_id = -1;
+  std::set<int> used_assassin_ids;
+  std::set<int> previous_targets;
+  std::vector<std::pair<int, int>> pending_assassins; // id, ms left
+  std::vector<std::pair<int, Player>> players;
+  std::vector<PlayerLooks> player_looks; // same order as players
+  std::unordered_map<int, int> input_seqs;
+  // the players' resume tokens, and how long the parked ones have left
+  std::unordered_map<int, std::string> tokens;
+  std::unordered_map<int, int> parked_ms;
+  std::vector<Bullet> bullets;
+};
+
+struct ServerState {
+  int64_t time_ms = 0;
+  int next_room_id = 0;
+  int world_tiles = 0;
+  bool authoritative = false;
+  std::vector<RoomState> rooms;
+};
+
+// copies every room under its locks. only copies, so the tick it runs
+// between isn't held up by the serializing afterwards
+ServerState capture_state_unlocked() {
+  ServerState state;
+  state.time_ms = sim_clock.now_ms();
+  state.next_room_id = next_room_id;
+  state.world_tiles = (int)PLAYING_AREA.width / TILE_SIZE;
+  state.authoritative = authoritative_movement;
+
+  for (const auto &[room_id, room] : rooms) {
+    state.rooms.emplace_back();
+    RoomState &r = state.rooms.back();
+    r.id = room_id;
+    r.seed = room->map_seed;
+
+    std::scoped_lock locks(room->game_mutex, room->assassin_mutex,
+                           room->pending_assassin_mutex, room->darkness_mutex,
+                           room->acid_rain_mutex);
+    r.snapshot_seq = room->snapshot_seq;
+    if (room->darkness_active)
+      r.darkness_ms = (int)room->timers.remaining_ms(room->darkness_timer);
+    if (room->acid_rain_active)
+      r.acid_rain_ms = (int)room->timers.remaining_ms(room->acid_rain_timer);
+    r.assassin_id = room->assassin_id;
+    r.assassin_target_id = room->assassin_target_id;
+    r.assassin_ms = (int)room->timers.remaining_ms(room->assassin_timer);
+    r.assassin_color = room->original_assassin_color;
+    r.last_assassin_id = room->last_assassin_id;
+    r.used_assassin_ids = room->used_assassin_ids;
+    r.previous_targets = room->previous_targets;
+    for (const auto &[id, timer] : room->pending_assassins)
+      r.pending_assassins.push_back({id, (int)room->timers.remaining_ms(timer)});
+
+    r.players.reserve(room->game.players.size());
+    r.player_looks.reserve(room->game.players.size());
+    for (const auto &[id, p] : room->game.players) {
+      r.players.push_back({id, p});
+      r.player_looks.push_back(room->game.players.looks(id));
+      if (!connections.in_use(id) || connections[id].room != room)
+        continue;
+      r.tokens[id] = connections[id].resume_token;
+      if (connections[id].parked_until_ms != -1)
+        r.parked_ms[id] = (int)std::max<int64_t>(
+            0, connections[id].parked_until_ms - steady_now_ms());
+    }
+    for (const auto &[id, input] : room->input_buffers)
+      r.input_seqs[id] = input.last_seq;
+    r.bullets.reserve(room->game.bullets.size());
+    for (size_t i = 0; i < room->game.bullets.size(); i++)
+      r.bullets.push_back(room->game.bullets.dense_at(i));
+  }
+  return state;
+}
+
+std::string handoff_record(int type,
+                           const std::map<std::string, netvent::Value> &fields) {
+  return netvent::serialize_to_netvent(netvent::val(type), fields);
+}
+
+netvent::Value int_list(const std::set<int> &ids) {
+  std::vector<netvent::Value> list;
+  for (int id : ids)
+    list.push_back(netvent::val(id));
+  return netvent::val(netvent::Table(list));
+}
+
+// the state as records, HANDOFF_SERVER first
+std::vector<std::string> state_records(const ServerState &state) {
+  std::vector<std::string> records;
+  records.push_back(handoff_record(
+      HANDOFF_SERVER,
+      {{"time_hi", netvent::val(time_hi(state.time_ms))},
+       {"time_lo", netvent::val(time_lo(state.time_ms))},
+       {"next_room_id", netvent::val(state.next_room_id)},
+       {"world_tiles", netvent::val(state.world_tiles)},
+       {"authoritative", netvent::val(state.authoritative ? 1 : 0)}}));
+
+  for (const RoomState &room : state.rooms) {
+    std::vector<netvent::Value> pending_ids, pending_ms;
+    for (const auto &[id, ms] : room.pending_assassins) {
+      pending_ids.push_back(netvent::val(id));
+      pending_ms.push_back(netvent::val(ms));
+    }
+    records.push_back(handoff_record(
+        HANDOFF_ROOM,
+        {{"id", netvent::val(room.id)},
+         {"seed", netvent::val((int)room.seed)},
+         {"snapshot_seq", netvent::val(room.snapshot_seq)},
+         {"darkness_ms", netvent::val(room.darkness_ms)},
+         {"acid_rain_ms", netvent::val(room.acid_rain_ms)},
+         {"assassin_id", netvent::val(room.assassin_id)},
+         {"assassin_target_id", netvent::val(room.assassin_target_id)},
+         {"assassin_ms", netvent::val(room.assassin_ms)},
+         {"assassin_color", netvent::val(color_to_table(room.assassin_color))},
+         {"last_assassin_id", netvent::val(room.last_assassin_id)},
+         {"used_assassin_ids", int_list(room.used_assassin_ids)},
+         {"previous_targets", int_list(room.previous_targets)},
+         {"pending_ids", netvent::val(netvent::Table(pending_ids))},
+         {"pending_ms", netvent::val(netvent::Table(pending_ms))}}));
+
+    for (size_t i = 0; i < room.players.size(); i++) {
+      const auto &[id, p] = room.players[i];
+      const PlayerLooks &looks = room.player_looks[i];
+      auto input = room.input_seqs.find(id);
+      auto token = room.tokens.find(id);
+      auto parked = room.parked_ms.find(id);
+      records.push_back(handoff_record(
+          HANDOFF_PLAYER,
+          {{"room", netvent::val(room.id)},
+           {"id", netvent::val(id)},
+           {"x", netvent::val(p.x)},
+           {"y", netvent::val(p.y)},
+           {"rot", netvent::val(p.rot)},
+           {"weapon_id", netvent::val(p.weapon_id)},
+           {"color", netvent::val(color_to_table(looks.color))},
+           {"username", netvent::val(looks.username)},
+           {"input_seq",
+            netvent::val(input == room.input_seqs.end() ? -1 : input->second)},
+           {"token",
+            netvent::val(token == room.tokens.end() ? "" : token->second)},
+           {"parked_ms",
+            netvent::val(parked == room.parked_ms.end() ? -1 : parked->second)}}));
+    }
+
+    for (const Bullet &b : room.bullets) {
+      records.push_back(handoff_record(
+          HANDOFF_BULLET,
+          {{"room", netvent::val(room.id)},
+           {"id", netvent::val(b.bullet_id)},
+           {"owner", netvent::val(b.shotby_id)},
+           {"x", netvent::val(b.spawn_x)},
+           {"y", netvent::val(b.spawn_y)},
+           {"vx", netvent::val(b.vx)},
+           {"vy", netvent::val(b.vy)},
+           {"spawn_tick", netvent::val(b.spawn_tick)},
+           {"tick", netvent::val(b.tick)},
+           {"rewind_ticks", netvent::val(b.rewind_ticks)},
+           {"local_id", netvent::val(b.local_id)}}));
+    }
+  }
+  return records;
+}
+
+void restore_room_unlocked(std::map<std::string, netvent::Value> &data) {
+  std::shared_ptr<Room> room =
+      create_room_unlocked((uint32_t)data["seed"].as_int(), data["id"].as_int());
+  Room *r = room.get();
+  room->snapshot_seq = data["snapshot_seq"].as_int();
+
+  if (data["darkness_ms"].as_int() >= 0) {
+    room->darkness_active = true;
+    room->darkness_timer = room->timers.schedule(
+        data["darkness_ms"].as_int(), [r]() { end_darkness_event(*r); });
+  }
+  if (data["acid_rain_ms"].as_int() >= 0) {
+    room->acid_rain_active = true;
+    room->acid_rain_timer = room->timers.schedule(
+        data["acid_rain_ms"].as_int(), [r]() { end_acid_rain_event(*r); });
+  }
+  room->assassin_id = data["assassin_id"].as_int();
+  room->assassin_target_id = data["assassin_target_id"].as_int();
+  room->original_assassin_color =
+      color_from_table(data["assassin_color"].as_table());
+  room->last_assassin_id = data["last_assassin_id"].as_int();
+  if (room->assassin_id != -1 && data["assassin_ms"].as_int() >= 0) {
+    room->assassin_timer = room->timers.schedule(
+        data["assassin_ms"].as_int(), [r]() { end_assassin_event(*r); });
+  }
+  for (const netvent::Value &id :
+       data["used_assassin_ids"].as_table().get_data_vector())
+    room->used_assassin_ids.insert(id.as_int());
+  for (const netvent::Value &id :
+       data["previous_targets"].as_table().get_data_vector())
+    room->previous_targets.insert(id.as_int());
+
+  std::vector<netvent::Value> pending_ids =
+      data["pending_ids"].as_table().get_data_vector();
+  std::vector<netvent::Value> pending_ms =
+      data["pending_ms"].as_table().get_data_vector();
+  for (size_t i = 0; i < pending_ids.size() && i < pending_ms.size(); i++) {
+    int id = pending_ids[i].as_int();
+    room->pending_assassins[id] = room->timers.schedule(
+        pending_ms[i].as_int(), [r, id]() { retarget_pending_assassin(*r, id); });
+  }
+}
+
+void restore_player_unlocked(std::map<std::string, netvent::Value> &data) {
+  auto room = rooms.find(data["room"].as_int());
+  if (room == rooms.end())
+    return;
+  Player p(data["x"].as_int(), data["y"].as_int());
+  p.rot = data["rot"].as_float();
+  p.weapon_id = data["weapon_id"].as_int();
+  PlayerLooks looks;
+  looks.color = color_from_table(data["color"].as_table());
+  looks.username = data["username"].as_string();
+
+  // every player comes back parked on its old id. a handoff gives it its
+  // socket right after (HANDOFF_CONNECTION), after a crash its client has
+  // to resume it
+  int id = data["id"].as_int();
+  std::string token = data["token"].as_string();
+  int parked_ms = data["parked_ms"].as_int();
+  {
+    std::lock_guard<std::mutex> lock(connections_mutex);
+    if (token.empty() || resume_tokens.count(token) || !connections.acquire_at(id))
+      return;
+    connections[id].socket = -1;
+  }
+  Connection &connection = connections[id];
+  connection.recv_buffer.clear();
+  connection.room = room->second;
+  connection.room->members++;
+  connection.resume_token = token;
+  connection.parked_until_ms =
+      steady_now_ms() + (parked_ms >= 0 ? parked_ms : RESUME_GRACE_MS);
+  connection.known_players.clear();
+  resume_tokens[token] = id;
+
+  Room &r = *room->second;
+  std::scoped_lock locks(r.game_mutex, r.clients_mutex);
+  r.game.players.insert({id, p}, looks);
+  if (authoritative_movement)
+    r.input_buffers[id].last_seq = data["input_seq"].as_int();
+  r.clients[id] = std::make_pair(-1, nullptr);
+  r.client_sessions[id] = next_session++;
+}
+
+void restore_bullet_unlocked(std::map<std::string, netvent::Value> &data) {
+  auto room = rooms.find(data["room"].as_int());
+  if (room == rooms.end())
+    return;
+  Bullet b(data["x"].as_int(), data["y"].as_int(), data["vx"].as_int(),
+           data["vy"].as_int(), data["spawn_tick"].as_int(),
+           data["owner"].as_int(), data["id"].as_int());
+  b.step_to(data["tick"].as_int());
+  b.rewind_ticks = data["rewind_ticks"].as_int();
+  b.local_id = data["local_id"].as_int();
+
+  // the handles are the ones clients know. the map is new, so nothing
+  // inserted later can land on them
+  std::lock_guard<std::mutex> lock(room->second->game_mutex);
+  room->second->game.bullets.insert_at(b.bullet_id, b);
+}
+
+// one record of state_records. throws on a malformed one
+void restore_record_unlocked(int type,
+                             std::map<std::string, netvent::Value> &data) {
+  if (type == HANDOFF_SERVER) {
+    sim_clock.sync(join_time(data["time_hi"].as_int(), data["time_lo"].as_int()));
+    next_room_id = data["next_room_id"].as_int();
+    // the maps (and the clients of a handoff) were made for this world and
+    // movement mode, whatever the flags say
+    set_playing_area_tiles(data["world_tiles"].as_int());
+    authoritative_movement = data["authoritative"].as_int() != 0;
+    std::lock_guard<std::mutex> lock(objects_mutex);
+    objects = map_landmarks();
+    init_landmarks_unlocked();
+  } else if (type == HANDOFF_ROOM) {
+    restore_room_unlocked(data);
+  } else if (type == HANDOFF_PLAYER) {
+    restore_player_unlocked(data);
+  } else if (type == HANDOFF_BULLET) {
+    restore_bullet_unlocked(data);
+  }
+}
+
+// ---------------------------------
+// END SAVED STATE
+// ---------------------------------
+
+// ---------------------------------
+// HOT RESTART
+// --handoff: the running server hands its sockets and state to the server
+// started after it (see handoff.hpp) and exits. players see one slow tick
+// instead of a disconnect
+// ---------------------------------
+
+static std::string handoff_path;
+// the successor waiting for the state, -1 if none. set by
+// wait_for_successor, cleared by the main loop if the handoff fails
+static std::atomic<int> handoff_peer{-1};
+
+// accepts the next server on the handoff socket, the main loop does the
+// rest at the end of a tick
+void wait_for_successor(int listener) {
+  while (server_running) {
+    int peer = accept_connection(listener, nullptr, nullptr);
+    if (peer < 0) {
+      if (errno != EINTR)
+        perror("Handoff accept failed");
+      continue;
+    }
+    handoff_set_timeout(peer, HANDOFF_TIMEOUT_MS);
+
+    bool asked = false;
+    std::string record;
+    int fd;
+    if (handoff_recv(peer, &record, &fd)) {
+      if (fd != -1)
+        close_socket(fd);
+      try {
+        asked = netvent::deserialize_from_netvent(record).first.as_int() ==
+                HANDOFF_REQUEST;
+      } catch (const std::exception &e) {
+        std::cerr << "Bad handoff request: " << e.what() << std::endl;
+      }
+    }
+    if (!asked) {
+      close_socket(peer);
+      continue;
+    }
+
+    std::cout << "A new server asks for a handoff" << std::endl;
+    handoff_peer = peer;
+    // one at a time, a failed handoff clears it
+    while (server_running && handoff_peer != -1)
+      std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  }
+}
+
+// waits until a thread is out of its blocking call, waking it as often as
+// it takes (the signal can land just before the call), and joins it
+void stop_thread(std::thread &thread, const std::atomic<bool> &busy) {
+  while (busy) {
+    handoff_wake(thread);
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  if (thread.joinable())
+    thread.join();
+}
+
+// stops the accept and recv threads, the sockets stay as they are. with
+// accept stopped only the main loop touches the slab
+void stop_receiving(std::thread &acceptor) {
+  accept_new = false;
+  stop_thread(acceptor, accepting);
+  {
+    // a resume moves a connection under this lock, and won't once it's
+    // stopped
+    std::lock_guard<std::mutex> lock(connections_mutex);
+    for (int id = 0; id < connections.capacity(); id++) {
+      if (connections.in_use(id))
+        connections[id].running = false;
+    }
+  }
+  for (int id = 0; id < connections.capacity(); id++) {
+    if (connections.in_use(id))
+      stop_thread(connections[id].thread, connections[id].receiving);
+  }
+}
+
+// the connection's recv thread, for a player that's already in its room
+void start_receiving(int id) {
+  Connection &connection = connections[id];
+  queue_received(connection, connections.handle(id));
+  connection.running = true;
+  connection.receiving = true;
+  connection.thread = std::thread(receive_packets, id);
+}
+
+// after a failed handoff
+void resume_receiving(std::thread &acceptor, int sock) {
+  for (int id = 0; id < connections.capacity(); id++) {
+    if (connections.in_use(id))
+      start_receiving(id);
+  }
+  accept_new = true;
+  accepting = true;
+  acceptor = std::thread(accept_clients, sock);
+}
+
+// sends the state record by record, with the listener and client sockets
+// attached. true once the successor has taken it all
+bool send_handoff(int peer) {
+  std::lock_guard<std::mutex> rooms_lock(rooms_mutex);
+  std::vector<std::string> records = state_records(capture_state_unlocked());
+  for (size_t i = 0; i < records.size(); i++) {
+    if (!handoff_send(peer, records[i], i == 0 ? server_socket_fd : -1))
+      return false;
+  }
+
+  // parked connections have no socket, their player records are enough
+  for (int id = 0; id < connections.capacity(); id++) {
+    if (!connections.in_use(id) || !connections[id].room ||
+        connections[id].socket == -1)
+      continue;
+    const Connection &c = connections[id];
+    if (!handoff_send(peer,
+                      handoff_record(HANDOFF_CONNECTION,
+                                     {{"id", netvent::val(id)},
+                                      {"pending",
+                                       netvent::val((int)c.recv_buffer.size())}}),
+                      c.socket))
+      return false;
+    if (!c.recv_buffer.empty() && !handoff_send(peer, c.recv_buffer))
+      return false;
+  }
+
+  if (!handoff_send(peer, handoff_record(HANDOFF_END, {})))
+    return false;
+
+  std::string record;
+  int fd;
+  if (!handoff_recv(peer, &record, &fd))
+    return false;
+  try {
+    return netvent::deserialize_from_netvent(record).first.as_int() ==
+           HANDOFF_DONE;
+  } catch (const std::exception &e) {
+    std::cerr << "Bad handoff reply: " << e.what() << std::endl;
+    return false;
+  }
+}
+
+// takes over from the server at the other end of peer. returns the
+// listening socket, -1 if the handoff failed (the old server then keeps
+// going). started ids get their recv threads once the old server let go
+int take_over(int peer) {
+  if (!handoff_send(peer, handoff_record(HANDOFF_REQUEST, {})))
+    return -1;
+
+  int listener = -1;
+  std::vector<int> adopted;
+  size_t room_count = 0;
+  try {
+    std::lock_guard<std::mutex> rooms_lock(rooms_mutex);
+    while (true) {
+      std::string record;
+      int fd;
+      if (!handoff_recv(peer, &record, &fd)) {
+        std::cerr << "Handoff interrupted" << std::endl;
+        return -1;
+      }
+      auto [type, data] = netvent::deserialize_from_netvent(record);
+
+      if (type.as_int() == HANDOFF_SERVER)
+        listener = fd;
+      if (type.as_int() == HANDOFF_CONNECTION) {
+        std::string pending;
+        int ignored;
+        if (data["pending"].as_int() > 0 &&
+            !handoff_recv(peer, &pending, &ignored)) {
+          std::cerr << "Handoff interrupted" << std::endl;
+          return -1;
+        }
+
+        // its player record parked it, this unparks it
+        int id = data["id"].as_int();
+        std::lock_guard<std::mutex> lock(connections_mutex);
+        if (fd == -1 || !connections.in_use(id) ||
+            connections[id].parked_until_ms == -1) {
+          if (fd != -1)
+            close_socket(fd);
+          continue;
         }
+        Connection &connection = connections[id];
+        connection.socket = fd;
+        connection.recv_buffer = pending;
+        connection.parked_until_ms = -1;
+
+        std::lock_guard<std::mutex> clients_lock(connection.room->clients_mutex);
+        connection.room->clients[id].first = fd;
+        adopted.push_back(id);
+      } else if (type.as_int() == HANDOFF_END) {
+        room_count = rooms.size();
+        break;
+      } else {
+        restore_record_unlocked(type.as_int(), data);
       }
     }
+  } catch (const std::exception &e) {
+    std::cerr << "Bad handoff record: " << e.what() << std::endl;
+    return -1;
+  }
 
-    if (should_despawn) {
-      // Send despawn message to all clients
-      std::string msg = netvent::serialize_to_netvent(
-          netvent::val(MSG_BULLET_DESPAWN),
-          std::map<std::string, netvent::Value>({
-              {"bullet_id", netvent::val(it->bullet_id)}
-          }));
-      broadcast_message(msg, clients);
+  if (listener == -1 || !handoff_send(peer, handoff_record(HANDOFF_DONE, {})))
+    return -1;
 
-      // Remove bullet
-      it = game.bullets.erase(it);
-    } else {
-      ++it;
+  for (int id : adopted)
+    start_receiving(id);
+  std::cout << "Took over " << adopted.size() << " clients in "
+            << room_count << " rooms" << std::endl;
+  return listener;
+}
+
+// ---------------------------------
+// END HOT RESTART
+// ---------------------------------
+
+// ---------------------------------
+// CHECKPOINTS
+// --checkpoint: the state goes to a mapped file every
+// CHECKPOINT_INTERVAL_MS (see checkpoint.hpp) and a server that crashed
+// starts again from it. the tick only copies, the checkpoint thread writes
+// ---------------------------------
+
+static std::string checkpoint_path;
+static CheckpointFile checkpoint_file;
+// the copy waiting for the checkpoint thread, a newer one replaces it
+// (guarded by checkpoint_mutex)
+static std::mutex checkpoint_mutex;
+static std::condition_variable checkpoint_wake;
+static std::unique_ptr<ServerState> checkpoint_next;
+static bool checkpoint_writing = false;
+
+void checkpoint_loop() {
+  while (true) {
+    std::unique_ptr<ServerState> state;
+    {
+      std::unique_lock<std::mutex> lock(checkpoint_mutex);
+      checkpoint_wake.wait(lock,
+                           [] { return checkpoint_next || !server_running; });
+      if (!server_running)
+        return;
+      state = std::move(checkpoint_next);
+      checkpoint_writing = true;
     }
+
+    auto start = std::chrono::steady_clock::now();
+    checkpoint_file.write(state_records(*state));
+    last_checkpoint_us = (int)std::chrono::duration_cast<std::chrono::microseconds>(
+                             std::chrono::steady_clock::now() - start)
+                             .count();
+
+    {
+      std::lock_guard<std::mutex> lock(checkpoint_mutex);
+      checkpoint_writing = false;
+    }
+    checkpoint_wake.notify_all();
   }
 }
 
-int main() {
+// between ticks: copies the state and hands it to the checkpoint thread
+void queue_checkpoint() {
+  auto start = std::chrono::steady_clock::now();
+  auto state = std::make_unique<ServerState>();
+  {
+    std::lock_guard<std::mutex> lock(rooms_mutex);
+    *state = capture_state_unlocked();
+  }
+  last_capture_us = (int)std::chrono::duration_cast<std::chrono::microseconds>(
+                        std::chrono::steady_clock::now() - start)
+                        .count();
+  {
+    std::lock_guard<std::mutex> lock(checkpoint_mutex);
+    checkpoint_next = std::move(state);
+  }
+  checkpoint_wake.notify_one();
+}
+
+// waits out a checkpoint in progress and drops a queued one. before a
+// handoff, so the successor is the only one writing the file
+void settle_checkpoints() {
+  std::unique_lock<std::mutex> lock(checkpoint_mutex);
+  checkpoint_next.reset();
+  checkpoint_wake.wait(lock, [] { return !checkpoint_writing; });
+}
+
+// rooms from the last checkpoint, false if there is none. the players
+// come back parked, for their clients to resume
+bool restore_checkpoint_unlocked() {
+  std::vector<std::string> records;
+  if (!checkpoint_file.read(&records) || records.empty())
+    return false;
+  try {
+    for (const std::string &record : records) {
+      auto [type, data] = netvent::deserialize_from_netvent(record);
+      restore_record_unlocked(type.as_int(), data);
+    }
+  } catch (const std::exception &e) {
+    std::cerr << "Bad checkpoint, starting fresh: " << e.what() << std::endl;
+    {
+      std::lock_guard<std::mutex> lock(connections_mutex);
+      for (const auto &[token, id] : resume_tokens) {
+        connections[id].room.reset();
+        connections[id].resume_token.clear();
+        connections[id].parked_until_ms = -1;
+        connections.release(id);
+      }
+    }
+    resume_tokens.clear();
+    rooms.clear();
+    next_room_id = 0;
+    return false;
+  }
+  return true;
+}
+
+// ---------------------------------
+// END CHECKPOINTS
+// ---------------------------------
+
+// the listening socket. with SO_REUSEPORT every worker of a supervisor
+// binds its own on the same port and the kernel balances joins over them
+int open_listener(int backlog) {
   int sock = create_socket(ADDRESS_FAMILY_INET, SOCKET_STREAM, 0);
   if (sock < 0) {
     perror("Failed to create socket");
     return -1;
   }
-  server_socket_fd = sock;
 
   socket_address_in sock_addr;
   sock_addr.sin_family = ADDRESS_FAMILY_INET;
@@ -929,318 +3137,238 @@ int main() {
     return -1;
   }
 
-  if (listen_socket(sock, 5) < 0) {
+  if (listen_socket(sock, backlog) < 0) {
     perror("Failed to listen on socket");
     close_socket(sock);
     return -1;
   }
+  return sock;
+}
 
-  std::thread(accept_clients, sock).detach();
-  std::thread(event_worker).detach();
-  std::thread(handle_stdin_commands).detach();
-
-  init_server_objects();
+int main(int argc, char **argv) {
+  unsigned threads = 0; // one per core, split between the workers
+  int workers = 0;
+  // joins that can wait for accept, a burst of them beyond this is refused
+  int backlog = SOCKET_MAX_BACKLOG;
+  uint32_t first_seed = std::random_device{}();
+  for (int i = 1; i < argc; i++) {
+    if (std::strcmp(argv[i], "--authoritative") == 0) {
+      authoritative_movement = true;
+    } else if (std::strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+      threads = (unsigned)std::atoi(argv[++i]);
+    } else if (std::strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+      first_seed = (uint32_t)std::strtoul(argv[++i], nullptr, 10);
+    } else if (std::strcmp(argv[i], "--world-tiles") == 0 && i + 1 < argc) {
+      // whole chunks only
+      int tiles = std::atoi(argv[++i]);
+      tiles = (tiles + CHUNK_TILES - 1) / CHUNK_TILES * CHUNK_TILES;
+      set_playing_area_tiles(std::max(CHUNK_TILES, std::min(MAX_WORLD_TILES, tiles)));
+    } else if (std::strcmp(argv[i], "--room-size") == 0 && i + 1 < argc) {
+      room_size = std::max(1, std::atoi(argv[++i]));
+    } else if (std::strcmp(argv[i], "--workers") == 0 && i + 1 < argc) {
+      workers = std::max(0, std::atoi(argv[++i]));
+    } else if (std::strcmp(argv[i], "--backlog") == 0 && i + 1 < argc) {
+      backlog = std::max(1, std::atoi(argv[++i]));
+    } else if (std::strcmp(argv[i], "--handoff") == 0 && i + 1 < argc) {
+      handoff_path = argv[++i];
+    } else if (std::strcmp(argv[i], "--checkpoint") == 0 && i + 1 < argc) {
+      checkpoint_path = argv[++i];
+    }
+  }
+  if (workers > 0 && !handoff_path.empty()) {
+    // every worker would need its own successor
+    std::cerr << "--handoff doesn't work with --workers, hot restart is off"
+              << std::endl;
+    handoff_path.clear();
+  }
+  if (authoritative_movement) {
+    std::cout << "Authoritative movement on" << std::endl;
+  }
 
-  std::cout << "Running.\n";
+  // --workers: fork them here, before any thread exists. each worker goes on
+  // below with its own listener, rooms and threads, the supervisor stays in
+  // run() until shutdown
+  Supervisor supervisor(workers);
+  WorkerHealth *health = nullptr;
+  if (workers > 0) {
+    std::signal(SIGINT, shutdown_server);
+    std::cout << "Supervising " << workers << " workers" << std::endl;
+    int worker = supervisor.run(server_running);
+    if (worker < 0) {
+      std::cout << "Workers stopped. Exiting..." << std::endl;
+      return 0;
+    }
+    health = &supervisor.health(worker);
+    // each worker has its own rooms
+    if (!checkpoint_path.empty())
+      checkpoint_path += "." + std::to_string(worker);
+  }
 
-  std::signal(SIGINT, shutdown_server);
+  if (threads == 0) {
+    threads = std::thread::hardware_concurrency() / std::max(1, workers);
+  }
+  // the tick forks from this thread, replication from its own
+  jobs.start(threads, 2);
+  std::cout << "Tick threads: " << jobs.thread_count() << std::endl;
+  std::cout << "World: " << world_chunks() << "x" << world_chunks()
+            << " chunks, " << room_size << " players per room" << std::endl;
 
-  while (server_running) {
-    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  sim_clock.start();
 
-    // check pending assassins
-    check_pending_assassins();
+  // before accepting, joins send what this builds. map objects don't need
+  // textures since the server doesn't render
+  {
+    std::lock_guard<std::mutex> lock(objects_mutex);
+    objects = map_landmarks();
+    init_landmarks_unlocked();
+  }
 
-    // terminate disconnected clients
-    std::list<int> to_remove;
-    {
-      std::lock_guard<std::mutex> lo(running_mutex);
-      if (!is_running.empty()) {
-        for (auto &[id, v] : is_running) {
-          if (!v) {
-            to_remove.push_back(id);
-          }
-        }
+  // --handoff: a server already running there hands everything over,
+  // otherwise this one starts fresh
+  int sock = -1;
+  if (!handoff_path.empty()) {
+    handoff_init_wake_signal();
+    int peer = handoff_connect(handoff_path);
+    if (peer != -1) {
+      std::cout << "Taking over from the server at " << handoff_path << std::endl;
+      sock = take_over(peer);
+      close_socket(peer);
+      if (sock < 0) {
+        std::cerr << "Takeover failed, the old server keeps running" << std::endl;
+        return -1;
       }
     }
+  }
 
-    if (!to_remove.empty()) {
-      std::scoped_lock all_locks(clients_mutex, game_mutex, running_mutex);
+  if (!checkpoint_path.empty() && !checkpoint_file.open_file(checkpoint_path))
+    checkpoint_path.clear();
 
-      for (int i : to_remove) {
-        try {
-          auto client_it = clients.find(i);
-          if (client_it == clients.end()) {
-            continue;
-          }
+  if (sock < 0) {
+    sock = open_listener(backlog);
+    if (sock < 0) {
+      return -1;
+    }
+    std::lock_guard<std::mutex> lock(rooms_mutex);
+    // after a crash the rooms come back with their maps and events (room 0
+    // among them), otherwise room 0 is always there and --seed is its map
+    if (!checkpoint_path.empty() && restore_checkpoint_unlocked()) {
+      std::cout << "Restored " << rooms.size() << " rooms from "
+                << checkpoint_path << ", " << resume_tokens.size()
+                << " players can resume" << std::endl;
+    } else {
+      create_room_unlocked(first_seed);
+    }
+  }
+  server_socket_fd = sock;
 
-          int socket_fd = client_it->second.first;
-          auto thread_ptr = client_it->second.second;
+  // and now wait for the one after us
+  if (!handoff_path.empty()) {
+    int listener = handoff_listen(handoff_path);
+    if (listener != -1)
+      std::thread(wait_for_successor, listener).detach();
+  }
 
-          if (thread_ptr && thread_ptr->joinable()) {
-            if (socket_fd != -1) {
-              shutdown_socket(socket_fd, SHUTDOWN_BOTH);
-            }
+  accepting = true;
+  std::thread acceptor(accept_clients, sock);
+  // workers share the supervisor's terminal, they run without a console
+  if (!health) {
+    std::thread(handle_stdin_commands).detach();
+  }
 
-            thread_ptr->join();
+  std::cout << "Running.\n";
 
-            if (socket_fd != -1) {
-              close_socket(socket_fd);
-            }
-          }
+  std::signal(SIGINT, shutdown_server);
+  // a client that resets mid write shows up as a send error, not a dead server
+  std::signal(SIGPIPE, SIG_IGN);
 
-          clients.erase(client_it);
-          game.players.erase(i);
-          is_running.erase(i);
+  std::thread replicator(replication_loop);
+  std::thread checkpointer;
+  if (!checkpoint_path.empty())
+    checkpointer = std::thread(checkpoint_loop);
+  int64_t last_checkpoint_ms = steady_now_ms();
 
-          std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  std::vector<std::shared_ptr<Room>> ticking;
+  int players = 0;
+  while (server_running) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    auto tick_start = std::chrono::steady_clock::now();
 
-          // notify other clients about disconnection
-          std::string out = netvent::serialize_to_netvent(
-              netvent::val(4 /* MSG_PLAYER_LEFT */),
-              std::map<std::string, netvent::Value>({{"id", netvent::val(i)}}));
-          for (const auto &[client_id, client_data] : clients) {
-            if (client_id != i && client_data.first != -1) {
-              send_message(out, client_data.first);
-            }
-          }
+    // a successor is waiting: nothing is read from here on, this tick
+    // handles what already came in and the state goes over after it
+    int successor = handoff_peer;
+    if (successor != -1)
+      stop_receiving(acceptor);
 
-          std::cout << "Removed client " << i << std::endl;
-        } catch (const std::exception &e) {
-          std::cerr << "Error cleaning up client " << i << ": " << e.what()
-                    << std::endl;
+    remove_disconnected_clients();
+    expire_parked_connections();
+
+    ticking.clear();
+    {
+      std::lock_guard<std::mutex> lock(rooms_mutex);
+      route_packets_unlocked();
+
+      // rooms nobody is in anymore, room 0 stays for quick play
+      for (auto it = rooms.begin(); it != rooms.end();) {
+        if (it->first != 0 && it->second->members == 0) {
+          std::cout << "Room " << it->first << " closed" << std::endl;
+          it = rooms.erase(it);
+        } else {
+          ticking.push_back(it->second);
+          ++it;
         }
       }
+      players = connections.size();
     }
 
-    // process packets
-    {
-      std::lock_guard<std::mutex> lock(packets_mutex);
-      if (!packets.empty()) {
-        packetlist current_packets;
-        current_packets.swap(packets);
-
-        for (const auto &[from_id, packet] : current_packets) {
-          try {
-            if (packet.empty())
-              continue;
-
-            int packet_type = std::stoi(packet.substr(0, packet.find('\n')));
-            std::string payload = packet; // if we substr the newline, the processing will break
-
-            switch (packet_type) {
-            case 2: {
-              // get the movement data
-              auto [event_name, data] =
-                  netvent::deserialize_from_netvent(payload);
-              if (event_name.as_int() == 2) {
-                int x = data["x"].as_int();
-                int y = data["y"].as_int();
-                float rot = data["rot"].as_float();
-
-                bool collision_occurred = false;
-                int current_assassin_id = -1;
-                int current_target_id = -1;
-
-                // check assassin collision first
-                {
-                  std::lock_guard<std::mutex> assassin_lock(assassin_mutex);
-                  if (assassin_id == from_id && assassin_target_id != -1) {
-                    current_assassin_id = assassin_id;
-                    current_target_id = assassin_target_id;
-                  }
-                }
-
-                // update game state and check collision
-                {
-                  std::lock_guard<std::mutex> z(game_mutex);
-                  if (game.players.find(from_id) == game.players.end())
-                    break;
-                  game.players.at(from_id).x = x;
-                  game.players.at(from_id).y = y;
-                  game.players.at(from_id).rot = rot;
-
-                  // check if this player is an assassin
-                  if (current_assassin_id == from_id &&
-                      current_target_id != -1) {
-                    if (check_assassin_collision(current_assassin_id,
-                                                 current_target_id, x, y,
-                                                 rot)) {
-                      collision_occurred = true;
-                    }
-                  }
-                }
-
-                // handle assassination
-                if (collision_occurred) {
-                  // ANDY SHALL HANDLE ASSASSIN DAMAGE HERE
-                  // TODO: Implement assassin damage
-                  std::cout << "ASSASSIN SUCCESS! Player "
-                            << current_assassin_id << " hit target "
-                            << current_target_id << std::endl;
-                  // Store current assassin as last assassin
-                  last_assassin_id = current_assassin_id;
-
-                  // Set assassin to target themselves for 5 seconds
-                  {
-                    std::scoped_lock locks(game_mutex, assassin_mutex,
-                                           pending_assassin_mutex,
-                                           clients_mutex);
-                    assassin_target_id = current_assassin_id; // Target self
-                    pending_assassins[current_assassin_id] =
-                        std::chrono::steady_clock::now();
-
-                    // Notify assassin of self-targeting
-                    std::string event_response = netvent::serialize_to_netvent(
-                        netvent::val(MSG_ASSASSIN_CHANGE),
-                        std::map<std::string, netvent::Value>({
-                            {"assassin_id", netvent::val(current_assassin_id)},
-                            {"target_id", netvent::val(current_assassin_id)}
-                        }));
-
-                    auto assassin_client = clients.find(current_assassin_id);
-                    if (assassin_client != clients.end()) {
-                      send_message(event_response,
-                                   assassin_client->second.first);
-                      std::cout << "Assassin " << current_assassin_id
-                                << " entering pending period (self-target)"
-                                << std::endl;
-                    }
-                  }
-                }
-
-                // Broadcast movement to other clients
-                {
-                  std::lock_guard<std::mutex> clients_lock(clients_mutex);
-                  for (const auto &[client_id, client_data] : clients) {
-                    if (client_id != from_id && client_data.first != -1) {
-                      std::string out = netvent::serialize_to_netvent(
-                          netvent::val(2 /* MSG_PLAYER_MOVE */),
-                          std::map<std::string, netvent::Value>(
-                              {{"x", netvent::val(x)},
-                               {"y", netvent::val(y)},
-                               {"rot", netvent::val(rot)},
-                               {"id", netvent::val(from_id)}}));
-                      send_message(out, client_data.first);
-                    }
-                  }
-                }
-              }
-            } break;
-            case 5: { // MSG_PLAYER_UPDATE
-              auto [event_name, data] =
-                  netvent::deserialize_from_netvent(payload);
-              if (event_name.as_int() == 5) {
-                std::string username = data["username"].as_string();
-                netvent::Table color_table = data["color"].as_table();
-
-                std::string sanitized_user = sanitize_username(username);
-
-                {
-                  std::lock_guard<std::mutex> lock(game_mutex);
-                  game.players[from_id].username = sanitized_user;
-                  game.players[from_id].color = color_from_table(color_table);
-                }
-
-                std::string response = netvent::serialize_to_netvent(
-                    netvent::val(5 /* MSG_PLAYER_UPDATE */),
-                    std::map<std::string, netvent::Value>(
-                        {{"id", netvent::val(from_id)},
-                         {"username", netvent::val(sanitized_user)},
-                         {"color", netvent::val(color_to_table(
-                                       game.players[from_id].color))}}));
-                broadcast_message(response, clients, from_id);
-              }
-            } break;
-            case 6: {
-              auto [event_name, data] = netvent::deserialize_from_netvent(payload);
-              if (event_name.as_int() == 6) {
-                unsigned int color_code = data["color_code"].as_int();
-
-                std::scoped_lock locks(game_mutex, clients_mutex);
-
-                game.players[from_id].color = uint_to_color(color_code);
-
-                std::string out = netvent::serialize_to_netvent(
-                    netvent::val(6),
-                    std::map<std::string, netvent::Value>({
-                        {"player_id", netvent::val(from_id)},
-                        {"color_code", netvent::val((int)color_code)}
-                    }));
-                broadcast_message(out, clients, from_id);
-              }
-            } break;
-            case 10: {
-              auto [event_name, data] =
-                  netvent::deserialize_from_netvent(payload);
-              if (event_name.as_int() == 10) {
-                int player_id = data["player_id"].as_int();
-                int x = data["x"].as_int();
-                int y = data["y"].as_int();
-                float rot = data["rot"].as_float();
-
-                std::scoped_lock locks(game_mutex, clients_mutex);
-
-                float angleRad = (-rot + 5) * DEG2RAD;
-                float bspeed = 10;
-
-                Vector2 dir = Vector2Scale({cosf(angleRad), -sinf(angleRad)}, -bspeed);
-                Vector2 spawnOffset = Vector2Scale({cosf(angleRad), -sinf(angleRad)}, -120);
-                Vector2 origin = {(float)game.players[from_id].x + 50,
-                                  (float)game.players[from_id].y + 50};
-                Vector2 spawnPos = Vector2Add(origin, spawnOffset);
-
-                int bullet_id = get_next_bullet_id();
-                Bullet new_bullet((int)spawnPos.x, (int)spawnPos.y, dir, from_id, bullet_id);
-                game.bullets.push_back(new_bullet);
-
-                std::string out = netvent::serialize_to_netvent(
-                    netvent::val(10 /* MSG_BULLET_SHOT */),
-                    std::map<std::string, netvent::Value>(
-                        {{"player_id", netvent::val(player_id)},
-                         {"bullet_id", netvent::val(bullet_id)},
-                         {"x", netvent::val(x)},
-                         {"y", netvent::val(y)},
-                         {"rot", netvent::val(rot)}}));
-                broadcast_message(out, clients);
-              }
-            } break;
-            case 12: { // MSG_SWITCH_WEAPON
-              auto [event_name, data] =
-                  netvent::deserialize_from_netvent(payload);
-              if (event_name.as_int() == 12) {
-                int player_id = data["player_id"].as_int();
-                int weapon_id = data["weapon_id"].as_int();
-
-                std::scoped_lock locks(game_mutex, clients_mutex);
-                if (game.players.find(player_id) != game.players.end()) {
-                  game.players[player_id].weapon_id = weapon_id;
-                  // Broadcast weapon change to all clients
-                  std::string out = netvent::serialize_to_netvent(
-                      netvent::val(12 /* MSG_SWITCH_WEAPON */),
-                      std::map<std::string, netvent::Value>(
-                          {{"player_id", netvent::val(player_id)},
-                           {"weapon_id", netvent::val(weapon_id)}}));
-                  broadcast_message(out, clients, from_id);
-                }
-              }
-            } break;
-            default:
-              std::cerr << "INVALID PACKET TYPE: " << packet_type << std::endl;
-              break;
-            }
-          } catch (const std::exception &e) {
-            std::cerr << "Error processing packet: " << e.what() << std::endl;
-          }
-        }
+    // a job per room. their bullets and snapshots fork again from inside
+    jobs.parallel_for(ticking.size(), 1, [&](size_t begin, size_t end) {
+      for (size_t r = begin; r < end; r++)
+        tick_room(*ticking[r]);
+    });
+    last_tick_us = (int)std::chrono::duration_cast<std::chrono::microseconds>(
+                       std::chrono::steady_clock::now() - tick_start)
+                       .count();
+
+    if (!checkpoint_path.empty() && successor == -1 &&
+        steady_now_ms() - last_checkpoint_ms >= CHECKPOINT_INTERVAL_MS) {
+      last_checkpoint_ms = steady_now_ms();
+      queue_checkpoint();
+    }
+
+    if (successor != -1) {
+      if (!checkpoint_path.empty())
+        settle_checkpoints();
+      if (send_handoff(successor)) {
+        // the sockets live on in the new server, nothing gets shut down
+        std::cout << "Handed over to the new server. Exiting..." << std::endl;
+        _Exit(0);
       }
+      std::cerr << "Handoff failed, carrying on" << std::endl;
+      close_socket(successor);
+      resume_receiving(acceptor, sock);
+      handoff_peer = -1;
     }
 
-    // update bullets
-    update_bullets();
+    // tells the supervisor we still tick
+    if (health) {
+      health->heartbeat_ms = steady_now_ms();
+      health->players = players;
+      health->rooms = (int)ticking.size();
+    }
   }
 
   std::cout << "Main loop stopped. Starting cleanup..." << std::endl;
+  {
+    std::lock_guard<std::mutex> lock(replication_mutex);
+  }
+  replication_wake.notify_all();
+  replicator.join();
+  {
+    std::lock_guard<std::mutex> lock(checkpoint_mutex);
+  }
+  checkpoint_wake.notify_all();
+  if (checkpointer.joinable())
+    checkpointer.join();
 
   // force exit after 5 seconds
   std::thread force_exit([]() {
@@ -1251,10 +3379,10 @@ int main() {
   force_exit.detach();
 
   try {
-    std::scoped_lock all_locks(packets_mutex, clients_mutex, game_mutex,
-                               running_mutex);
-
-    packets.clear();
+    {
+      std::lock_guard<std::mutex> lock(packets_mutex);
+      packets.clear();
+    }
 
     // close sock
     if (server_socket_fd != -1) {
@@ -1262,26 +3390,37 @@ int main() {
       shutdown_socket(server_socket_fd, SHUTDOWN_BOTH);
       close_socket(server_socket_fd);
     }
+    // accept returns once the socket is gone. no locks held for the joins,
+    // the threads take connections_mutex on their way out
+    if (acceptor.joinable()) {
+      acceptor.join();
+    }
 
-    // terminate clients
-    for (auto &[id, client_pair] : clients) {
-      if (client_pair.second && client_pair.second->joinable()) {
-        if (client_pair.first != -1) {
-          shutdown_socket(client_pair.first, SHUTDOWN_BOTH);
-        }
-
-        client_pair.second->join();
-
-        if (client_pair.first != -1) {
-          close_socket(client_pair.first);
+    // terminate clients: wake them all under the lock, join them after
+    std::vector<std::thread> client_threads;
+    std::vector<int> client_sockets;
+    {
+      std::lock_guard<std::mutex> lock(connections_mutex);
+      for (int id = 0; id < connections.capacity(); id++) {
+        Connection &c = connections[id];
+        if (connections.in_use(id) && c.thread.joinable()) {
+          if (c.socket != -1) {
+            shutdown_socket(c.socket, SHUTDOWN_BOTH);
+            client_sockets.push_back(c.socket);
+          }
+          client_threads.push_back(std::move(c.thread));
         }
       }
     }
+    for (std::thread &t : client_threads) {
+      t.join();
+    }
+    for (int sock : client_sockets) {
+      close_socket(sock);
+    }
 
     // clear data
-    clients.clear();
-    game.players.clear();
-    is_running.clear();
+    jobs.stop();
 
     std::cout << "Cleanup complete. Exiting..." << std::endl;
     exit(0);
@@ -0,0 +1,36 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+
+// fixed simulation rate shared by the server and clients
+const int SIM_TICK_RATE = 60;
+
+inline int64_t clock_ms() {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+// netvent ints are 32 bit and a millisecond clock outgrows that after about
+// 24 days, so times go over the wire as two halves
+inline int time_hi(int64_t ms) { return (int)(ms >> 32); }
+inline int time_lo(int64_t ms) { return (int)(uint32_t)ms; }
+inline int64_t join_time(int hi, int lo) {
+  return (int64_t)(((uint64_t)(uint32_t)hi << 32) | (uint32_t)lo);
+}
+
+// server time base. the server starts it at 0 when it boots, clients sync it
+// from the server_time in MSG_CLIENT_ID. a client ends up behind by the one
+// way latency, which makes remote bullets appear at their spawn point on
+// arrival instead of already in flight
+class SimClock {
+public:
+  void start() { offset_ms = -clock_ms(); }
+  void sync(int64_t server_ms) { offset_ms = server_ms - clock_ms(); }
+
+  int64_t now_ms() const { return clock_ms() + offset_ms; }
+  int tick() const { return (int)(now_ms() * SIM_TICK_RATE / 1000); }
+
+private:
+  int64_t offset_ms = 0;
+};
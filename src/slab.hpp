@@ -0,0 +1,109 @@
+#pragma once
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+// fixed-capacity table of records that never move, for things that are
+// looked up by a small int id and hold threads, sockets or atomics (the
+// server's connections). ids come off a freelist, so taking and returning
+// one is O(1) and ids stay below the peak number in use.
+//
+// every slot has a generation that goes up when it's released. a handle
+// (same packing as SlotMap: index in the low 16 bits, generation in the next
+// 15) names one use of a slot, so anything still carrying the handle of a
+// released slot can tell it's stale.
+//
+// not synchronized, callers guard acquire / release and whatever they share
+template <typename T>
+class Slab {
+public:
+  static const int INDEX_BITS = 16;
+  static const int INDEX_MASK = (1 << INDEX_BITS) - 1;
+  static const int GENERATION_MASK = 0x7FFF;
+  static const int MAX_CAPACITY = INDEX_MASK + 1;
+
+  explicit Slab(int capacity)
+      : count(capacity < 1 ? 1 : capacity > MAX_CAPACITY ? MAX_CAPACITY : capacity),
+        records(new T[count]), slots(count) {
+    // lowest ids first
+    for (int i = count - 1; i >= 0; i--) {
+      slots[i].next_free = free_head;
+      free_head = i;
+    }
+  }
+
+  // takes a free slot and returns its index, -1 when all are in use
+  int acquire() {
+    if (free_head == -1)
+      return -1;
+    int index = free_head;
+    free_head = slots[index].next_free;
+    slots[index].in_use = true;
+    used++;
+    return index;
+  }
+
+  // takes one particular slot, false if it's in use. walks the freelist, so
+  // it's for rebuilding a table (a hot restart), not for every connection
+  bool acquire_at(int index) {
+    if (index < 0 || index >= count || slots[index].in_use)
+      return false;
+    int *link = &free_head;
+    while (*link != index)
+      link = &slots[*link].next_free;
+    *link = slots[index].next_free;
+    slots[index].in_use = true;
+    used++;
+    return true;
+  }
+
+  // returns a slot. the record is left as it is, the next user resets it
+  void release(int index) {
+    Slot &slot = slots[index];
+    if (!slot.in_use)
+      return;
+    slot.in_use = false;
+    slot.generation = (slot.generation + 1) & GENERATION_MASK;
+    slot.next_free = free_head;
+    free_head = index;
+    used--;
+  }
+
+  int handle(int index) const {
+    return (slots[index].generation << INDEX_BITS) | index;
+  }
+
+  // the index a handle names, -1 once that slot was released
+  int resolve(int handle) const {
+    if (handle < 0)
+      return -1;
+    int index = handle & INDEX_MASK;
+    if (index >= count || !slots[index].in_use ||
+        slots[index].generation != ((handle >> INDEX_BITS) & GENERATION_MASK))
+      return -1;
+    return index;
+  }
+
+  bool in_use(int index) const {
+    return index >= 0 && index < count && slots[index].in_use;
+  }
+
+  T &operator[](int index) { return records[index]; }
+  const T &operator[](int index) const { return records[index]; }
+
+  int capacity() const { return count; }
+  int size() const { return used; }
+
+private:
+  struct Slot {
+    int generation = 0;
+    int next_free = -1;
+    bool in_use = false;
+  };
+
+  int count;
+  std::unique_ptr<T[]> records;
+  std::vector<Slot> slots;
+  int free_head = -1;
+  int used = 0;
+};
@@ -0,0 +1,145 @@
+#pragma once
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+// dense storage with stable generational handles. a handle packs the slot
+// index (low 16 bits) and the slot's generation (next 15 bits) so it stays a
+// positive int and can go on the wire as-is. erasing bumps the generation, so
+// an old handle never resolves to whatever reuses its slot.
+//
+// values are packed contiguously (swap-remove on erase), so iteration is a
+// plain linear walk and spawn / lookup / despawn are all O(1).
+template <typename T>
+class SlotMap {
+public:
+  static const int INDEX_BITS = 16;
+  static const int INDEX_MASK = (1 << INDEX_BITS) - 1;
+  static const int GENERATION_MASK = 0x7FFF;
+  static const int MAX_SLOTS = INDEX_MASK + 1;
+
+  static int make_handle(int index, int generation) {
+    return ((generation & GENERATION_MASK) << INDEX_BITS) | (index & INDEX_MASK);
+  }
+  static int handle_index(int handle) { return handle & INDEX_MASK; }
+  static int handle_generation(int handle) {
+    return (handle >> INDEX_BITS) & GENERATION_MASK;
+  }
+
+  // allocates a slot and returns its handle, -1 if every slot is taken
+  int insert(const T &value) {
+    int index;
+    if (free_head != -1) {
+      index = free_head;
+      free_head = slots[index].next_free;
+    } else {
+      if ((int)slots.size() >= MAX_SLOTS)
+        return -1;
+      index = (int)slots.size();
+      slots.push_back(Slot());
+    }
+    place(index, value);
+    return make_handle(index, slots[index].generation);
+  }
+
+  // mirrors a handle allocated elsewhere (the client copies the server's
+  // handles). whatever still lives in that slot is replaced. a map should use
+  // either insert or insert_at, not both
+  bool insert_at(int handle, const T &value) {
+    if (handle < 0)
+      return false;
+    int index = handle_index(handle);
+    if (index >= (int)slots.size())
+      slots.resize(index + 1);
+    if (slots[index].dense != -1)
+      values[slots[index].dense] = value;
+    else
+      place(index, value);
+    slots[index].generation = handle_generation(handle);
+    return true;
+  }
+
+  T *get(int handle) {
+    int dense = dense_index(handle);
+    return dense == -1 ? nullptr : &values[dense];
+  }
+
+  bool contains(int handle) const { return dense_index(handle) != -1; }
+
+  bool erase(int handle) {
+    int dense = dense_index(handle);
+    if (dense == -1)
+      return false;
+    erase_dense(dense);
+    return true;
+  }
+
+  // removes the value at a dense position; the last value moves into it
+  void erase_dense(size_t dense) {
+    int index = dense_to_slot[dense];
+    size_t last = values.size() - 1;
+    if (dense != last) {
+      values[dense] = std::move(values[last]);
+      dense_to_slot[dense] = dense_to_slot[last];
+      slots[dense_to_slot[dense]].dense = (int)dense;
+    }
+    values.pop_back();
+    dense_to_slot.pop_back();
+
+    slots[index].dense = -1;
+    slots[index].generation = (slots[index].generation + 1) & GENERATION_MASK;
+    slots[index].next_free = free_head;
+    free_head = index;
+  }
+
+  int handle_at(size_t dense) const {
+    int index = dense_to_slot[dense];
+    return make_handle(index, slots[index].generation);
+  }
+
+  T &dense_at(size_t dense) { return values[dense]; }
+  const T &dense_at(size_t dense) const { return values[dense]; }
+
+  size_t size() const { return values.size(); }
+  bool empty() const { return values.empty(); }
+
+  void clear() {
+    for (size_t i = values.size(); i > 0; i--)
+      erase_dense(i - 1);
+  }
+
+  typename std::vector<T>::iterator begin() { return values.begin(); }
+  typename std::vector<T>::iterator end() { return values.end(); }
+  typename std::vector<T>::const_iterator begin() const { return values.begin(); }
+  typename std::vector<T>::const_iterator end() const { return values.end(); }
+
+private:
+  struct Slot {
+    int generation = 0;
+    int dense = -1;
+    int next_free = -1;
+  };
+
+  std::vector<Slot> slots;
+  std::vector<T> values;
+  std::vector<int> dense_to_slot;
+  int free_head = -1;
+
+  void place(int index, const T &value) {
+    slots[index].dense = (int)values.size();
+    values.push_back(value);
+    dense_to_slot.push_back(index);
+  }
+
+  int dense_index(int handle) const {
+    if (handle < 0)
+      return -1;
+    int index = handle_index(handle);
+    if (index >= (int)slots.size())
+      return -1;
+    const Slot &slot = slots[index];
+    if (slot.dense == -1 || slot.generation != handle_generation(handle))
+      return -1;
+    return slot.dense;
+  }
+};
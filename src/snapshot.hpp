@@ -0,0 +1,151 @@
+#pragma once
+#include "clrfn.hpp"
+#include "netvent.hpp"
+#include "player.hpp"
+#include <raylib.h>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// how often the server sends each client a snapshot
+const int SNAPSHOT_INTERVAL_MS = 50;
+// snapshots each side remembers, a baseline older than this means a full resend
+const int SNAPSHOT_RING = 32;
+// a client whose connection drops gets its player back (MSG_RESUME) if it
+// reconnects within this long. the server keeps the player and what the
+// client acked meanwhile, so it resumes on deltas instead of a full join
+const int RESUME_GRACE_MS = 30000;
+
+// the replicated part of a player
+struct PlayerState {
+  int x = 0;
+  int y = 0;
+  float rot = 0;
+  int weapon_id = 0;
+  Color color = RED;
+  std::string username;
+};
+
+inline void copy_player_fields(PlayerState &s, const Player &p,
+                               const PlayerLooks &looks, int fields) {
+  if (fields & FIELD_POS) {
+    s.x = p.x;
+    s.y = p.y;
+  }
+  if (fields & FIELD_ROT)
+    s.rot = p.rot;
+  if (fields & FIELD_WEAPON)
+    s.weapon_id = p.weapon_id;
+  if (fields & FIELD_COLOR)
+    s.color = looks.color;
+  if (fields & FIELD_USERNAME)
+    s.username = looks.username;
+}
+
+// PlayerField bits that differ between two states
+inline int player_state_diff(const PlayerState &a, const PlayerState &b) {
+  int fields = 0;
+  if (a.x != b.x || a.y != b.y)
+    fields |= FIELD_POS;
+  if (a.rot != b.rot)
+    fields |= FIELD_ROT;
+  if (a.weapon_id != b.weapon_id)
+    fields |= FIELD_WEAPON;
+  if (!color_equal(a.color, b.color))
+    fields |= FIELD_COLOR;
+  if (a.username != b.username)
+    fields |= FIELD_USERNAME;
+  return fields;
+}
+
+// one entry of a snapshot: the id plus only the given fields
+inline netvent::Table player_state_delta(int id, const PlayerState &s, int fields) {
+  netvent::Table t = netvent::map_table({{"id", netvent::val(id)}});
+  if (fields & FIELD_POS) {
+    t.push_back(netvent::val("x"), netvent::val(s.x));
+    t.push_back(netvent::val("y"), netvent::val(s.y));
+  }
+  if (fields & FIELD_ROT)
+    t.push_back(netvent::val("rot"), netvent::val(s.rot));
+  if (fields & FIELD_WEAPON)
+    t.push_back(netvent::val("weapon_id"), netvent::val(s.weapon_id));
+  if (fields & FIELD_COLOR)
+    t.push_back(netvent::val("color"), netvent::val(color_to_table(s.color)));
+  if (fields & FIELD_USERNAME)
+    t.push_back(netvent::val("username"), netvent::val(s.username));
+  return t;
+}
+
+// applies an entry written by player_state_delta, returns the fields it had
+inline int apply_player_state_delta(PlayerState &s, netvent::Table &t) {
+  int fields = 0;
+  if (t.exists(netvent::val("x"))) {
+    s.x = t[netvent::val("x")].as_int();
+    s.y = t[netvent::val("y")].as_int();
+    fields |= FIELD_POS;
+  }
+  if (t.exists(netvent::val("rot"))) {
+    s.rot = t[netvent::val("rot")].as_float();
+    fields |= FIELD_ROT;
+  }
+  if (t.exists(netvent::val("weapon_id"))) {
+    s.weapon_id = t[netvent::val("weapon_id")].as_int();
+    fields |= FIELD_WEAPON;
+  }
+  if (t.exists(netvent::val("color"))) {
+    s.color = color_from_table(t[netvent::val("color")].as_table());
+    fields |= FIELD_COLOR;
+  }
+  if (t.exists(netvent::val("username"))) {
+    s.username = t[netvent::val("username")].as_string();
+    fields |= FIELD_USERNAME;
+  }
+  return fields;
+}
+
+// what one client knows about the other players as of a snapshot
+struct SnapshotView {
+  int seq = -1;
+  std::unordered_map<int, PlayerState> players;
+};
+
+// the last SNAPSHOT_RING views, indexed by sequence number
+class SnapshotRing {
+public:
+  SnapshotView *find(int seq) {
+    if (seq < 0)
+      return nullptr;
+    SnapshotView &view = views[seq % SNAPSHOT_RING];
+    return view.seq == seq ? &view : nullptr;
+  }
+
+  void put(SnapshotView view) {
+    int seq = view.seq;
+    views[seq % SNAPSHOT_RING] = std::move(view);
+  }
+
+private:
+  SnapshotView views[SNAPSHOT_RING];
+};
+
+// one tick of the world as everything outside the simulation sees it:
+// replication, joins, the console. built by the tick thread and never
+// changed once published, so readers share it without locks
+struct WorldSnapshot {
+  int seq = -1; // snapshot sequence if this tick goes out to clients
+  int tick = 0;
+  int64_t time_ms = 0;
+  std::unordered_map<int, PlayerState> players;
+  // connected clients that have a player, with their join session. a new
+  // session on a reused id starts replication for it over
+  std::vector<std::pair<int, int>> clients;
+  // clients that dropped and may still resume, same form
+  std::vector<std::pair<int, int>> parked;
+  std::unordered_map<int, int> input_acks; // newest input applied per player
+  int assassin_id = -1;
+  int assassin_target_id = -1;
+  bool darkness = false;
+  bool acid_rain = false;
+};
@@ -0,0 +1,215 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <new>
+#include <thread>
+#include <vector>
+
+#if __unix__
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+#if __linux__
+#include <sys/prctl.h>
+#endif
+
+// supervisor mode (--workers): the server forks that many worker processes.
+// each opens its own SO_REUSEPORT listener on the same port and runs its own
+// rooms, so the kernel spreads new connections over them and one host uses
+// all its cores without any locking between workers. the supervisor only
+// watches: a worker that exits or stops beating is replaced
+
+// a worker without a heartbeat for this long is taken to be hung
+const int WORKER_STALL_MS = 5000;
+// a slot is restarted at most this often, so a crash loop doesn't spin
+const int WORKER_RESTART_DELAY_MS = 1000;
+// how long workers get to shut down before they're killed
+const int WORKER_SHUTDOWN_MS = 6000;
+// how often the supervisor logs what its workers host
+const int WORKER_REPORT_MS = 60 * 1000;
+
+inline int64_t steady_now_ms() {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+// what a worker reports to the supervisor. lives in memory shared across
+// the fork, so only lock-free atomics go in here
+struct WorkerHealth {
+  std::atomic<int64_t> heartbeat_ms{0}; // steady_now_ms of the last tick
+  std::atomic<int> players{0};
+  std::atomic<int> rooms{0};
+};
+
+class Supervisor {
+public:
+  explicit Supervisor(int workers) : slots(workers < 1 ? 1 : workers) {}
+
+  // forks the workers and watches them while running is set. returns in
+  // each worker with its index, and in the supervisor with -1 once every
+  // worker is gone
+  int run(const std::atomic<bool> &running) {
+#if __unix__
+    void *shared = mmap(nullptr, sizeof(WorkerHealth) * slots.size(),
+                        PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (shared == MAP_FAILED) {
+      perror("Failed to map worker health");
+      return -1;
+    }
+    health_slots = static_cast<WorkerHealth *>(shared);
+    for (size_t i = 0; i < slots.size(); i++)
+      new (&health_slots[i]) WorkerHealth();
+
+    for (int i = 0; i < (int)slots.size(); i++) {
+      if (spawn(i))
+        return i;
+    }
+
+    int64_t next_report = steady_now_ms() + WORKER_REPORT_MS;
+    while (running) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(100));
+      reap();
+      int64_t now = steady_now_ms();
+      if (now >= next_report) {
+        report();
+        next_report = now + WORKER_REPORT_MS;
+      }
+      for (int i = 0; i < (int)slots.size(); i++) {
+        Slot &slot = slots[i];
+        if (slot.pid == -1) {
+          if (now >= slot.restart_at_ms && running && spawn(i))
+            return i;
+          continue;
+        }
+        int64_t beat = health_slots[i].heartbeat_ms;
+        if (!slot.killed && now - beat > WORKER_STALL_MS) {
+          std::cerr << "Worker " << i << " (pid " << slot.pid << ") missed its heartbeat for "
+                    << now - beat << " ms, killing it" << std::endl;
+          kill(slot.pid, SIGKILL);
+          slot.killed = true;
+        }
+      }
+    }
+
+    stop_workers();
+    return -1;
+#else
+    (void)running;
+    std::cerr << "--workers needs fork(), running a single process" << std::endl;
+    health_slots = &single;
+    return 0;
+#endif
+  }
+
+  // the calling worker's slot
+  WorkerHealth &health(int index) { return health_slots[index]; }
+
+private:
+  struct Slot {
+    int pid = -1;
+    int64_t started_ms = 0;
+    int64_t restart_at_ms = 0;
+    bool killed = false; // SIGKILL sent, waiting to reap it
+  };
+
+  std::vector<Slot> slots;
+  WorkerHealth *health_slots = nullptr;
+  WorkerHealth single;
+
+#if __unix__
+  // true in the new worker
+  bool spawn(int index) {
+    Slot &slot = slots[index];
+    // a fresh worker gets the whole stall window to start up
+    health_slots[index].heartbeat_ms = steady_now_ms();
+    health_slots[index].players = 0;
+    health_slots[index].rooms = 0;
+
+    pid_t pid = fork();
+    if (pid == 0) {
+#if __linux__
+      // don't outlive the supervisor
+      prctl(PR_SET_PDEATHSIG, SIGINT);
+#endif
+      return true;
+    }
+    if (pid < 0) {
+      perror("Failed to fork worker");
+      slot.restart_at_ms = steady_now_ms() + WORKER_RESTART_DELAY_MS;
+      return false;
+    }
+
+    slot.pid = pid;
+    slot.started_ms = steady_now_ms();
+    slot.killed = false;
+    std::cout << "Worker " << index << " started (pid " << pid << ")" << std::endl;
+    return false;
+  }
+
+  void report() {
+    std::cout << "Workers:";
+    for (size_t i = 0; i < slots.size(); i++) {
+      if (slots[i].pid == -1) {
+        std::cout << " " << i << " down;";
+      } else {
+        std::cout << " " << i << " " << health_slots[i].players << " players in "
+                  << health_slots[i].rooms << " rooms;";
+      }
+    }
+    std::cout << std::endl;
+  }
+
+  // picks up workers that exited and schedules their restart
+  void reap() {
+    int status;
+    pid_t pid;
+    while ((pid = waitpid(-1, &status, WNOHANG)) > 0) {
+      for (int i = 0; i < (int)slots.size(); i++) {
+        Slot &slot = slots[i];
+        if (slot.pid != pid)
+          continue;
+        if (WIFSIGNALED(status)) {
+          std::cerr << "Worker " << i << " (pid " << pid << ") killed by signal "
+                    << WTERMSIG(status) << std::endl;
+        } else {
+          std::cerr << "Worker " << i << " (pid " << pid << ") exited with "
+                    << WEXITSTATUS(status) << std::endl;
+        }
+        slot.pid = -1;
+        slot.restart_at_ms = slot.started_ms + WORKER_RESTART_DELAY_MS;
+      }
+    }
+  }
+
+  void stop_workers() {
+    for (Slot &slot : slots) {
+      if (slot.pid != -1)
+        kill(slot.pid, SIGINT);
+    }
+    int64_t deadline = steady_now_ms() + WORKER_SHUTDOWN_MS;
+    while (steady_now_ms() < deadline) {
+      reap();
+      bool any = false;
+      for (Slot &slot : slots)
+        any = any || slot.pid != -1;
+      if (!any)
+        return;
+      std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    }
+    for (Slot &slot : slots) {
+      if (slot.pid != -1) {
+        std::cerr << "Worker pid " << slot.pid << " didn't stop, killing it" << std::endl;
+        kill(slot.pid, SIGKILL);
+        waitpid(slot.pid, nullptr, 0);
+        slot.pid = -1;
+      }
+    }
+  }
+#endif
+};
@@ -0,0 +1,201 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+// hierarchical timing wheel (same layout as the classic linux kernel timer
+// base): 256 slots of one tick, then three levels of 64 slots that cascade
+// down as time reaches them. schedule and cancel are O(1), and advance only
+// touches the slot for each tick that passed.
+//
+// schedule / cancel may be called from any thread. callbacks run on whichever
+// thread calls advance (the server tick), with no wheel lock held, so they can
+// schedule or cancel timers themselves.
+class TimerWheel {
+public:
+  typedef std::function<void()> Callback;
+
+  explicit TimerWheel(int64_t resolution_ms = 10) : resolution_ms(resolution_ms) {
+    for (auto &level : wheel)
+      for (int &head : level)
+        head = -1;
+  }
+
+  void start(int64_t now_ms) {
+    std::lock_guard<std::mutex> lock(mutex);
+    now_tick = now_ms / resolution_ms;
+  }
+
+  // fires no earlier than delay_ms from now (at most one tick late). returns
+  // a handle for cancel, handles go stale once the timer fires
+  int schedule(int64_t delay_ms, Callback cb) {
+    std::lock_guard<std::mutex> lock(mutex);
+    int index = alloc();
+    Timer &t = timers[index];
+    int64_t delay = (delay_ms + resolution_ms - 1) / resolution_ms;
+    t.expires = now_tick + (delay > 0 ? delay : 0);
+    t.cb = std::move(cb);
+    link(index);
+    return make_handle(index, t.generation);
+  }
+
+  bool cancel(int handle) {
+    std::lock_guard<std::mutex> lock(mutex);
+    int index = resolve(handle);
+    if (index == -1)
+      return false;
+    unlink(index);
+    release(index);
+    return true;
+  }
+
+  // ms until a timer fires (0 if it's due), -1 once the handle is stale
+  int64_t remaining_ms(int handle) {
+    std::lock_guard<std::mutex> lock(mutex);
+    int index = resolve(handle);
+    if (index == -1)
+      return -1;
+    int64_t ticks = timers[index].expires - now_tick;
+    return ticks > 0 ? ticks * resolution_ms : 0;
+  }
+
+  // runs everything that expired up to now_ms
+  void advance(int64_t now_ms) {
+    int64_t target = now_ms / resolution_ms;
+    std::unique_lock<std::mutex> lock(mutex);
+    while (now_tick <= target) {
+      int index = (int)(now_tick & ROOT_MASK);
+      if (index == 0 && cascade(1) == 0 && cascade(2) == 0)
+        cascade(3);
+      now_tick++;
+
+      // pop one at a time, a callback may cancel others in the same slot
+      while (wheel[0][index] != -1) {
+        int timer = wheel[0][index];
+        unlink(timer);
+        Callback cb = std::move(timers[timer].cb);
+        release(timer);
+
+        lock.unlock();
+        cb();
+        lock.lock();
+      }
+    }
+  }
+
+private:
+  static const int ROOT_BITS = 8;
+  static const int LEVEL_BITS = 6;
+  static const int ROOT_SIZE = 1 << ROOT_BITS;
+  static const int LEVEL_SIZE = 1 << LEVEL_BITS;
+  static const int64_t ROOT_MASK = ROOT_SIZE - 1;
+  static const int64_t LEVEL_MASK = LEVEL_SIZE - 1;
+  static const int LEVELS = 4;
+
+  struct Timer {
+    int64_t expires = 0;
+    Callback cb;
+    int prev = -1, next = -1;
+    int level = -1, slot = -1;
+    int generation = 0;
+  };
+
+  int64_t resolution_ms;
+  int64_t now_tick = 0; // next tick to process
+  std::mutex mutex;
+  std::vector<Timer> timers;
+  int free_head = -1;
+  // slot heads, level 0 uses all 256, the others the first 64
+  int wheel[LEVELS][ROOT_SIZE];
+
+  static int make_handle(int index, int generation) {
+    return ((generation & 0x7FFF) << 16) | index;
+  }
+
+  int resolve(int handle) const {
+    if (handle < 0)
+      return -1;
+    int index = handle & 0xFFFF;
+    if (index >= (int)timers.size())
+      return -1;
+    const Timer &t = timers[index];
+    if (t.level == -1 || (t.generation & 0x7FFF) != ((handle >> 16) & 0x7FFF))
+      return -1;
+    return index;
+  }
+
+  int alloc() {
+    if (free_head != -1) {
+      int index = free_head;
+      free_head = timers[index].next;
+      return index;
+    }
+    timers.push_back(Timer());
+    return (int)timers.size() - 1;
+  }
+
+  void release(int index) {
+    Timer &t = timers[index];
+    t.cb = nullptr;
+    t.level = -1;
+    t.generation++;
+    t.next = free_head;
+    free_head = index;
+  }
+
+  void link(int index) {
+    Timer &t = timers[index];
+    int64_t expires = t.expires < now_tick ? now_tick : t.expires;
+    int64_t delta = expires - now_tick;
+    int64_t max_delta = ((int64_t)1 << (ROOT_BITS + (LEVELS - 1) * LEVEL_BITS)) - 1;
+    if (delta > max_delta) {
+      expires = now_tick + max_delta;
+      delta = max_delta;
+    }
+
+    if (delta < ROOT_SIZE) {
+      t.level = 0;
+      t.slot = (int)(expires & ROOT_MASK);
+    } else {
+      int level = 1;
+      while (level < LEVELS - 1 &&
+             delta >= ((int64_t)1 << (ROOT_BITS + level * LEVEL_BITS)))
+        level++;
+      t.level = level;
+      t.slot = (int)((expires >> (ROOT_BITS + (level - 1) * LEVEL_BITS)) & LEVEL_MASK);
+    }
+
+    int &head = wheel[t.level][t.slot];
+    t.prev = -1;
+    t.next = head;
+    if (head != -1)
+      timers[head].prev = index;
+    head = index;
+  }
+
+  void unlink(int index) {
+    Timer &t = timers[index];
+    if (t.prev != -1)
+      timers[t.prev].next = t.next;
+    else
+      wheel[t.level][t.slot] = t.next;
+    if (t.next != -1)
+      timers[t.next].prev = t.prev;
+    t.prev = t.next = -1;
+  }
+
+  // moves every timer in the current slot of a level down a level, returns
+  // the slot index so the caller knows whether the next level also wrapped
+  int cascade(int level) {
+    int slot = (int)((now_tick >> (ROOT_BITS + (level - 1) * LEVEL_BITS)) & LEVEL_MASK);
+    int index = wheel[level][slot];
+    wheel[level][slot] = -1;
+    while (index != -1) {
+      int next = timers[index].next;
+      link(index);
+      index = next;
+    }
+    return slot;
+  }
+};
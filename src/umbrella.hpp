@@ -1,10 +1,12 @@
 #pragma once
+#include <algorithm>
 #include <raylib.h>
 #include <vector>
-#include <set>
 #include "constants.hpp"
 #include "resource_manager.hpp"
+#include "aabb.hpp"
 #include "bullet.hpp"
+#include "slot_map.hpp"
 
 class Umbrella {
     public:
@@ -12,7 +14,6 @@ class Umbrella {
         bool is_usable = true;
         bool is_active = false;
         Color tint = WHITE;
-        std::set<int> hit_by_bullets;
 
         Umbrella() {}
         ~Umbrella() {}
@@ -23,11 +24,12 @@ class Umbrella {
             }
         }
 
-        bool update(Rectangle barrel, Rectangle player, std::vector<Rectangle> bullets, std::vector<Bullet>& game_bullets, bool is_active) {
+        // called once per client tick, dt is the tick length in seconds
+        bool update(Rectangle barrel, Rectangle player, const AabbBatch& bullets, SlotMap<Bullet>& game_bullets, bool is_active, float dt) {
             if (CheckCollisionRecs(barrel, player)) {
                 how_many_times_hit = 0;
                 is_usable = true;
-                hit_by_bullets.clear();
+                for (Bullet& bullet : game_bullets) bullet.hit_umbrella = false;
             }
             if (!is_active) return is_usable;
             // update our position (align with visual position)
@@ -39,32 +41,31 @@ class Umbrella {
             };
             
             if (is_usable) {
-                hit_cooldown -= GetFrameTime();
+                hit_cooldown -= dt;
                 
                 // fade tint back to white
-                if (tint.r < 255) tint.r += 5;
-                if (tint.g < 255) tint.g += 5;
-                if (tint.b < 255) tint.b += 5;
+                tint.r = (unsigned char)std::min(255, tint.r + 5);
+                tint.g = (unsigned char)std::min(255, tint.g + 5);
+                tint.b = (unsigned char)std::min(255, tint.b + 5);
 
                 bool was_hit = false;
-                for (size_t i = 0; i < bullets.size(); i++) {
-                    const Rectangle& bullet_rect = bullets[i];
-                    const Bullet& bullet = game_bullets[i];
+                // bullets overlapping the umbrella, in order
+                for (int i = aabb_first_hit(our_position, bullets);
+                     i >= 0 && hit_cooldown <= 0; i = aabb_first_hit(our_position, bullets, i + 1)) {
+                    Bullet& bullet = game_bullets.dense_at(i);
                     
-                    if (hit_cooldown <= 0 && CheckCollisionRecs(our_position, bullet_rect)) {
-                        if (hit_by_bullets.find(bullet.bullet_id) == hit_by_bullets.end()) {
-                            how_many_times_hit++;
-                            hit_cooldown = 0.5f; // cooldown between hits
-                            was_hit = true;
-                            hit_by_bullets.insert(bullet.bullet_id);
-                            std::cout << "Umbrella hit by bullet " << bullet.bullet_id << "! Hits: " << how_many_times_hit << std::endl;
-                            if (how_many_times_hit >= UMBRELLA_HIT_LIMIT) {
-                                is_usable = false;
-                                std::cout << "Umbrella destroyed!" << std::endl;
-                                break;
-                            }
+                    if (!bullet.hit_umbrella) {
+                        how_many_times_hit++;
+                        hit_cooldown = 0.5f; // cooldown between hits
+                        was_hit = true;
+                        bullet.hit_umbrella = true;
+                        std::cout << "Umbrella hit by bullet " << bullet.bullet_id << "! Hits: " << how_many_times_hit << std::endl;
+                        if (how_many_times_hit >= UMBRELLA_HIT_LIMIT) {
+                            is_usable = false;
+                            std::cout << "Umbrella destroyed!" << std::endl;
+                            break;
                         }
-                    }                
+                    }
                 }
                 
                 // Set red tint on hit
@@ -3,6 +3,7 @@
 
 #include "raylib.h"
 #include "player.hpp"
+#include "player_store.hpp"
 #include "constants.hpp"
 #include "drawScale.hpp"
 #include "networking.hpp"
@@ -19,7 +20,7 @@
 
 const Color INVISIBLE = BLANK;
 
-typedef std::map<int, Player> playermap;
+typedef PlayerStore playermap;
 typedef std::pair<int, std::shared_ptr<std::thread>> client;
 
 inline bool operator<(const Color& a, const Color& b) {
@@ -108,11 +109,11 @@ inline void send_message(std::string msg, int sock) {
   }
 }
 
-inline void broadcast_message(std::string msg,
-                              std::unordered_map<int, client> clients,
+inline void broadcast_message(const std::string &msg,
+                              const std::unordered_map<int, client> &clients,
                               int exclude = -1000) {
-  for (auto &[_, s] : clients)
-    if (_ != exclude)
+  for (const auto &[_, s] : clients)
+    if (_ != exclude && s.first != -1)
       send_message(msg, s.first);
 }
 
@@ -0,0 +1,182 @@
+#pragma once
+#include "aabb.hpp"
+#include "collision.hpp"
+#include "constants.hpp"
+#include "map_rng.hpp"
+#include "objects.hpp"
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+// the world is cut into square chunks. the server builds them as players
+// and bullets get near, clients only keep the few around their player, so
+// neither memory nor per frame loops grow with the size of the world
+const int CHUNK_TILES = 10;
+const int CHUNK_SIZE = TILE_SIZE * CHUNK_TILES;
+// chunks around the player's own a client loads, and how far away a loaded
+// one has to be before it's dropped again (the gap stops a player walking
+// along a border from reloading the same chunks)
+const int CHUNK_LOAD_RADIUS = 1;
+const int CHUNK_EVICT_RADIUS = 2;
+// the largest world a server will make, in tiles per side
+const int MAX_WORLD_TILES = CHUNK_TILES * 64;
+// more than the biggest thing that collides with the map (players are 50px,
+// bullets smaller)
+const float CHUNK_NEAR_MARGIN = 100.0f;
+
+inline int chunk_of(float v) { return (int)std::floor(v / CHUNK_SIZE); }
+// shifted unsigned, the coordinates can be negative (a neighbour at the edge)
+inline int64_t chunk_key(int cx, int cy) {
+  return (int64_t)(((uint64_t)(uint32_t)cx << 32) | (uint32_t)cy);
+}
+// chunks per side of the current world
+inline int world_chunks() { return (int)PLAYING_AREA.width / CHUNK_SIZE; }
+inline bool chunk_in_world(int cx, int cy) {
+  return cx >= 0 && cy >= 0 && cx < world_chunks() && cy < world_chunks();
+}
+inline Rectangle chunk_area(int cx, int cy) {
+  return {(float)(cx * CHUNK_SIZE), (float)(cy * CHUNK_SIZE), (float)CHUNK_SIZE,
+          (float)CHUNK_SIZE};
+}
+
+struct Chunk {
+  int x = 0, y = 0;
+  // map objects centered in this chunk. the same for every map of a world
+  // size, so the server's rooms share one copy
+  std::shared_ptr<const std::vector<Object>> objects;
+  std::vector<Object> cubes;
+};
+
+// map objects whose center is in the chunk
+inline std::vector<Object> chunk_objects(const std::vector<Object> &landmarks,
+                                         int cx, int cy) {
+  std::vector<Object> inside;
+  for (const Object &object : landmarks) {
+    if (chunk_of(object.bounds.x + object.bounds.width / 2) == cx &&
+        chunk_of(object.bounds.y + object.bounds.height / 2) == cy) {
+      inside.push_back(object);
+    }
+  }
+  return inside;
+}
+
+// the cubes of one chunk. every chunk draws from its own stream, so any chunk
+// can be built on its own, in any order
+inline std::vector<Object> chunk_cubes(uint32_t seed, int cx, int cy,
+                                       const std::vector<Object> &landmarks) {
+  MapRng base(seed);
+  uint64_t stream = ((uint64_t)base.next() << 32) | base.next();
+  stream ^= (uint64_t)chunk_key(cx, cy) * 0x9e3779b97f4a7c15ull;
+  return get_rand_cubes(stream, chunk_area(cx, cy), MAP_CUBE_SIZE, landmarks);
+}
+
+// loaded chunks plus, for every chunk next to one, the colliders that reach
+// into it or within CHUNK_NEAR_MARGIN of it, taken from it and its 8
+// neighbours. anything no bigger than the margin only touches those, so a
+// query is one lookup and a scan of about a chunk's worth of boxes, however
+// big the world is.
+//
+// the near colliders are rebuilt on put/erase, so reads need no locking as
+// long as nobody changes the map at the same time
+class ChunkMap {
+public:
+  typedef std::unordered_map<int64_t, Chunk>::iterator iterator;
+  typedef std::unordered_map<int64_t, Chunk>::const_iterator const_iterator;
+
+  void put(Chunk chunk) {
+    int cx = chunk.x, cy = chunk.y;
+    chunks[chunk_key(cx, cy)] = std::move(chunk);
+    rebuild_near(cx, cy);
+  }
+
+  bool erase(int cx, int cy) {
+    if (!chunks.erase(chunk_key(cx, cy)))
+      return false;
+    rebuild_near(cx, cy);
+    return true;
+  }
+
+  void clear() {
+    chunks.clear();
+    near.clear();
+  }
+
+  Chunk *find(int cx, int cy) {
+    auto it = chunks.find(chunk_key(cx, cy));
+    return it == chunks.end() ? nullptr : &it->second;
+  }
+  const Chunk *find(int cx, int cy) const {
+    auto it = chunks.find(chunk_key(cx, cy));
+    return it == chunks.end() ? nullptr : &it->second;
+  }
+
+  size_t size() const { return chunks.size(); }
+  iterator begin() { return chunks.begin(); }
+  iterator end() { return chunks.end(); }
+  const_iterator begin() const { return chunks.begin(); }
+  const_iterator end() const { return chunks.end(); }
+
+  // what movement at (x, y) collides with (cube_move_colliders)
+  const AabbBatch &cube_colliders_near(float x, float y) const {
+    auto it = near.find(chunk_key(chunk_of(x), chunk_of(y)));
+    return it == near.end() ? empty : it->second.cube_colliders;
+  }
+
+  // what bullets at (x, y) despawn on: map objects and cubes
+  const AabbBatch &static_colliders_near(float x, float y) const {
+    auto it = near.find(chunk_key(chunk_of(x), chunk_of(y)));
+    return it == near.end() ? empty : it->second.static_colliders;
+  }
+
+private:
+  struct Near {
+    AabbBatch cube_colliders;
+    AabbBatch static_colliders;
+  };
+
+  std::unordered_map<int64_t, Chunk> chunks;
+  std::unordered_map<int64_t, Near> near;
+  AabbBatch empty;
+
+  // a chunk changed, so did the near colliders of it and its neighbours
+  void rebuild_near(int cx, int cy) {
+    for (int ny = cy - 1; ny <= cy + 1; ny++) {
+      for (int nx = cx - 1; nx <= cx + 1; nx++) {
+        Near built;
+        bool any = false;
+        Rectangle area = chunk_area(nx, ny);
+        Rectangle reach = {area.x - CHUNK_NEAR_MARGIN, area.y - CHUNK_NEAR_MARGIN,
+                           area.width + CHUNK_NEAR_MARGIN * 2,
+                           area.height + CHUNK_NEAR_MARGIN * 2};
+        for (int y = ny - 1; y <= ny + 1; y++) {
+          for (int x = nx - 1; x <= nx + 1; x++) {
+            const Chunk *chunk = find(x, y);
+            if (!chunk)
+              continue;
+            any = true;
+            if (chunk->objects) {
+              for (const Object &object : *chunk->objects) {
+                if (CheckCollisionRecs(object.bounds, reach))
+                  built.static_colliders.push_back(object.bounds);
+              }
+            }
+            for (const Object &cube : chunk->cubes) {
+              if (CheckCollisionRecs(cube.bounds, reach))
+                built.static_colliders.push_back(cube.bounds);
+              Rectangle move = cube_move_collider(cube);
+              if (CheckCollisionRecs(move, reach))
+                built.cube_colliders.push_back(move);
+            }
+          }
+        }
+        if (any) {
+          near[chunk_key(nx, ny)] = std::move(built);
+        } else {
+          near.erase(chunk_key(nx, ny));
+        }
+      }
+    }
+  }
+};